@@ -3,28 +3,350 @@
 
 """The implementation of consumer-side loading."""
 
+from __future__ import annotations
+
+import functools
 import importlib
+import importlib.util
+import os
+import sys
+from typing import TYPE_CHECKING
+
+if TYPE_CHECKING:
+    from collections.abc import Iterable
+
+    from shared_lib_manager import LibraryLoader
+
+# The entry point group in which packages using shared_lib_manager register the
+# modules that ship libraries.
+ENTRY_POINT_GROUP = "shared_lib_manager.libraries"
+
+# The name of the manifest file written by packages using shared_lib_manager. This
+# must match shared_lib_manager.MANIFEST_NAME, which is not imported here so that
+# looking for a manifest works even without shared_lib_manager installed.
+_MANIFEST_NAME = "shared_libs.json"
+
+# The names of modules found not to exist. Consumers commonly try to load optional
+# providers that are not installed, and without this every attempt would scan all of
+# sys.path again. The cache lasts for the life of the process unless
+# importlib.invalidate_caches() is called, see _CacheInvalidator.
+_MISSING_MODULES: set[str] = set()
+
+
+class _CacheInvalidator:
+    """A meta path finder that finds nothing but clears the caches of this module.
+
+    `importlib.invalidate_caches` calls ``invalidate_caches`` on every finder in
+    `sys.meta_path`, which is the only notification Python gives that packages may
+    have been installed since the caches were filled.
+    """
+
+    @staticmethod
+    def find_spec(*_: object) -> None:
+        """Find nothing, leaving the import to the other finders."""
+
+    @staticmethod
+    def invalidate_caches() -> None:
+        """Forget the modules found to be missing and the registered modules."""
+        _MISSING_MODULES.clear()
+        registered_library_modules.cache_clear()
+
+
+sys.meta_path.append(_CacheInvalidator())
+
+
+def _is_missing(module_name: str, error: ModuleNotFoundError) -> bool:
+    """Check whether an import failed because the module itself does not exist.
+
+    A module that exists but fails to import one of its own dependencies raises the
+    same exception, and must not be remembered as missing.
+    """
+    return error.name is not None and (
+        error.name == module_name or module_name.startswith(f"{error.name}.")
+    )
+
+
+def _find_manifest(module_name: str) -> str | None:
+    """Find the library manifest of a module without importing the module.
+
+    Parameters
+    ----------
+    module_name : str
+        The name of the module shipping the libraries.
+
+    Returns
+    -------
+    str | None
+        The path to the manifest, or None if the module does not exist or has no
+        manifest. Modules that do not exist are added to the negative cache.
+
+    """
+    if module_name in _MISSING_MODULES:
+        return None
+    try:
+        spec = importlib.util.find_spec(module_name)
+    except ModuleNotFoundError as e:
+        if not _is_missing(module_name, e):
+            raise
+        spec = None
+    except (ImportError, ValueError):
+        return None
+    if spec is None:
+        _MISSING_MODULES.add(module_name)
+        return None
+    if not spec.submodule_search_locations:
+        return None
+    for location in spec.submodule_search_locations:
+        manifest = os.path.join(location, _MANIFEST_NAME)
+        if os.path.isfile(manifest):
+            return manifest
+    return None
+
+
+@functools.lru_cache(maxsize=None)
+def registered_library_modules() -> tuple[str, ...]:
+    """Get the names of all installed modules that register shared libraries.
+
+    The modules are discovered from the package metadata of the environment in a
+    single scan, without importing any of them. The result is computed once per
+    process, or again after `importlib.invalidate_caches` is called.
+
+    Returns
+    -------
+    tuple[str, ...]
+        The names of the modules, which may be passed to `load_library_module`.
+
+    """
+    from importlib.metadata import entry_points
+
+    eps = entry_points()
+    if hasattr(eps, "select"):
+        group = eps.select(group=ENTRY_POINT_GROUP)
+    else:
+        # Python 3.9 returns a dict of groups.
+        group = eps.get(ENTRY_POINT_GROUP, ())
+    return tuple(sorted({ep.value for ep in group}))
+
+
+def _find_loader(
+    module_name: str, *, registered_only: bool = False
+) -> LibraryLoader | None:
+    """Get the loader of a module, if the module exists.
+
+    If the module ships a library manifest, the loader is created from the manifest
+    without importing the module at all. Otherwise the module is imported and its
+    ``loader`` attribute is used. Modules that do not exist are remembered, so that
+    looking for them again costs nothing until `importlib.invalidate_caches` is
+    called. Modules that exist but fail to import one of their dependencies are not
+    remembered, and the error is raised.
+
+    Parameters
+    ----------
+    module_name : str
+        The name of the module shipping the libraries.
+    registered_only : bool
+        If True, modules not in `registered_library_modules` are treated as missing
+        without searching the import path for them.
 
+    Returns
+    -------
+    LibraryLoader | None
+        The loader, or None if the module does not exist.
 
-def load_library_module(module_name: str, *, prefer_system: bool = False) -> None:
+    """
+    if registered_only and module_name not in registered_library_modules():
+        return None
+    manifest = _find_manifest(module_name)
+    if manifest is not None:
+        import shared_lib_manager
+
+        return shared_lib_manager.LibraryLoader.from_manifest(manifest)
+
+    if module_name in _MISSING_MODULES:
+        return None
+    try:
+        module = importlib.import_module(module_name)
+    except ModuleNotFoundError as e:
+        if not _is_missing(module_name, e):
+            raise
+        _MISSING_MODULES.add(module_name)
+        return None
+    return module.loader
+
+
+def load_library_modules(  # noqa: PLR0913
+    module_names: Iterable[str],
+    *,
+    prefer_system: bool = False,
+    lazy: bool = False,
+    trigger: str | None = None,
+    parallel: bool | int = False,
+    warmup: bool = False,
+    registered_only: bool = False,
+) -> None:
+    """Load the libraries of several modules as a single batch, if the modules exist.
+
+    Modules that do not exist are skipped, as in `load_library_module`. The libraries
+    of all the modules are loaded in one pass with `shared_lib_manager.load_all`, so
+    that libraries shipped by more than one module are only opened once and parallel
+    loads share a single thread pool.
+
+    Parameters
+    ----------
+    module_names : typing.Iterable[str]
+        The names of the modules to load.
+    prefer_system : bool
+        Whether or not to try loading system libraries before the local versions.
+    lazy : bool
+        If True, defer loading the libraries until an extension module in the
+        ``trigger`` package is imported.
+    trigger : str | None
+        The name of the package whose extension modules trigger a lazy load, typically
+        the ``__name__`` of the calling package. If None, any extension module triggers
+        the load.
+    parallel : bool | int
+        Whether to open the libraries concurrently, and optionally the maximum number
+        of threads to use.
+    warmup : bool
+        Whether to prefetch the library files into the page cache before loading them.
+        For lazy loads the files are prefetched in the background right away.
+    registered_only : bool
+        If True, only modules registered in the package metadata are loaded, see
+        `registered_library_modules`. This avoids searching the import path for
+        providers that are not installed.
+
+    """
+    loaders = [
+        loader
+        for loader in (
+            _find_loader(module_name, registered_only=registered_only)
+            for module_name in dict.fromkeys(module_names)
+        )
+        if loader is not None
+    ]
+    if not loaders:
+        return
+    if lazy:
+        for loader in loaders:
+            loader.load(
+                prefer_system=prefer_system,
+                lazy=True,
+                trigger=trigger,
+                parallel=parallel,
+                warmup=warmup,
+            )
+        return
+
+    import shared_lib_manager
+
+    shared_lib_manager.load_all(
+        loaders, prefer_system=prefer_system, parallel=parallel, warmup=warmup
+    )
+
+
+def load_library_module(
+    module_name: str,
+    *,
+    prefer_system: bool = False,
+    lazy: bool = False,
+    trigger: str | None = None,
+    warmup: bool = False,
+    registered_only: bool = False,
+) -> None:
     """Load the specified module, if it exists.
 
     The function allows the module to not exist so that it may be used by a consumer in
     non-pip contexts (for example, if the library is instead installed by some other
     package manager and so no wheel exists).
 
+    If the module ships a library manifest, the libraries are loaded from the manifest
+    without importing the module at all. Otherwise the module is imported and its
+    ``loader`` is used. Modules found not to exist are not searched for again until
+    `importlib.invalidate_caches` is called.
+
     Parameters
     ----------
     module_name : str
         The name of the module to load.
     prefer_system : bool
         Whether or not to try loading a system library before the local version.
+    lazy : bool
+        If True, defer loading the libraries until an extension module in the
+        ``trigger`` package is imported.
+    trigger : str | None
+        The name of the package whose extension modules trigger a lazy load, typically
+        the ``__name__`` of the calling package. If None, any extension module triggers
+        the load.
+    warmup : bool
+        Whether to prefetch the library files into the page cache before loading them.
+        For lazy loads the files are prefetched in the background right away.
+    registered_only : bool
+        If True, only modules registered in the package metadata are loaded, see
+        `registered_library_modules`. This avoids searching the import path for
+        providers that are not installed.
 
     """
-    try:
-        module = importlib.import_module(module_name)
-    except ModuleNotFoundError:
-        pass
-    else:
-        module.loader.load(prefer_system=prefer_system)
-        del module
+    loader = _find_loader(module_name, registered_only=registered_only)
+    if loader is not None:
+        loader.load(
+            prefer_system=prefer_system, lazy=lazy, trigger=trigger, warmup=warmup
+        )
+
+
+async def load_library_module_async(
+    module_name: str,
+    *,
+    prefer_system: bool = False,
+    warmup: bool = False,
+    registered_only: bool = False,
+) -> None:
+    """Load the specified module, if it exists, without blocking the event loop.
+
+    This is the asynchronous counterpart of `load_library_module`. Finding the module
+    and its manifest, and loading the libraries with
+    `shared_lib_manager.LibraryLoader.load_async`, both happen on the default executor
+    of the running event loop. Concurrent calls for the same module share one load.
+
+    Parameters
+    ----------
+    module_name : str
+        The name of the module to load.
+    prefer_system : bool
+        Whether or not to try loading a system library before the local version.
+    warmup : bool
+        Whether to prefetch the library files into the page cache before loading them.
+    registered_only : bool
+        If True, only modules registered in the package metadata are loaded, see
+        `registered_library_modules`. This avoids searching the import path for
+        providers that are not installed.
+
+    """
+    import asyncio
+
+    loader = await asyncio.get_running_loop().run_in_executor(
+        None,
+        functools.partial(_find_loader, module_name, registered_only=registered_only),
+    )
+    if loader is not None:
+        await loader.load_async(prefer_system=prefer_system, warmup=warmup)
+
+
+def find_library_conflicts() -> list[str]:
+    """Find symbol conflicts between the libraries of all registered modules.
+
+    The libraries are inspected without loading them, see
+    `shared_lib_manager.find_conflicts`.
+
+    Returns
+    -------
+    list[str]
+        A description of each problem found.
+
+    """
+    import shared_lib_manager
+
+    return shared_lib_manager.find_conflicts(
+        loader
+        for loader in map(_find_loader, registered_library_modules())
+        if loader is not None
+    )
@@ -0,0 +1,710 @@
+// SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION & AFFILIATES.
+// SPDX-License-Identifier: Apache-2.0
+
+// Optional compiled companion to shared_lib_manager. It opens libraries directly with
+// dlopen/LoadLibraryExW so that loading does not require importing ctypes, and opens a
+// whole batch of libraries in a single call with the GIL released. It also keeps a
+// registry of the loaded libraries that is shared by all interpreters in the process,
+// detects the CPU features used to choose between variants of a library, and reports
+// the memory mapped to each library where that requires system calls.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#ifdef __APPLE__
+#include <libproc.h>
+#include <sys/proc_info.h>
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+// Statically defined tracing probes around each dlopen call, for perf, bpftrace and
+// SystemTap to attach to. They compile to a single no-op instruction, so they cost
+// nothing unless a tracer enables them:
+//
+//   bpftrace -e 'usdt:/path/to/_shared_lib_manager.so:shared_lib_manager:load__done
+//                { printf("%s\n", str(arg0)); }'
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_USDT 1
+#endif
+#endif
+#ifdef HAVE_USDT
+#define TRACE_LOAD_START(path, flags) \
+  DTRACE_PROBE2(shared_lib_manager, load__start, path, flags)
+#define TRACE_LOAD_DONE(path, handle) \
+  DTRACE_PROBE2(shared_lib_manager, load__done, path, handle)
+#else
+#define TRACE_LOAD_START(path, flags)
+#define TRACE_LOAD_DONE(path, handle)
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define HAVE_X86_FEATURES 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define HAVE_ARM64_FEATURES 1
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef AT_HWCAP2
+#define AT_HWCAP2 26
+#endif
+#elif defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+#endif
+
+#ifdef _WIN32
+#define strdup _strdup
+#endif
+
+#ifdef _WIN32
+typedef wchar_t *native_path;
+typedef DWORD native_error;
+#else
+typedef PyObject *native_path;  // A bytes object holding the encoded path.
+typedef char *native_error;     // A copy of the dlerror message.
+#endif
+
+static int convert_path(PyObject *path, native_path *result) {
+#ifdef _WIN32
+  PyObject *decoded = NULL;
+  if (!PyUnicode_FSDecoder(path, &decoded)) {
+    return 0;
+  }
+  *result = PyUnicode_AsWideCharString(decoded, NULL);
+  Py_DECREF(decoded);
+  return *result != NULL;
+#else
+  return PyUnicode_FSConverter(path, result);
+#endif
+}
+
+static void free_path(native_path path) {
+#ifdef _WIN32
+  PyMem_Free(path);
+#else
+  Py_XDECREF(path);
+#endif
+}
+
+// A monotonic clock in seconds used to time individual loads.
+static double monotonic_seconds(void) {
+#ifdef _WIN32
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+static PyObject *error_message(native_error error) {
+#ifdef _WIN32
+  wchar_t *buffer = NULL;
+  DWORD length = FormatMessageW(
+      FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
+          FORMAT_MESSAGE_IGNORE_INSERTS,
+      NULL, error, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPWSTR)&buffer, 0,
+      NULL);
+  PyObject *message;
+  if (length == 0) {
+    message = PyUnicode_FromFormat("[WinError %lu]", (unsigned long)error);
+  } else {
+    // Strip the trailing line break that FormatMessageW adds.
+    while (length > 0 && (buffer[length - 1] == L'\n' || buffer[length - 1] == L'\r')) {
+      --length;
+    }
+    PyObject *text = PyUnicode_FromWideChar(buffer, length);
+    message =
+        text ? PyUnicode_FromFormat("[WinError %lu] %U", (unsigned long)error, text)
+             : NULL;
+    Py_XDECREF(text);
+  }
+  LocalFree(buffer);
+  return message;
+#else
+  if (error == NULL) {
+    return PyUnicode_FromString("unknown dlopen error");
+  }
+  return PyUnicode_DecodeFSDefault(error);
+#endif
+}
+
+// preload(paths, flags) -> list[tuple[int, str | None, float]]
+//
+// Open each path with the given flags, in order. The result contains one entry per
+// path holding the handle (0 on failure), the error message (None on success), and the
+// time in seconds spent opening the library.
+static PyObject *preload(PyObject *self, PyObject *args) {
+  PyObject *paths;
+  int flags;
+  if (!PyArg_ParseTuple(args, "Oi", &paths, &flags)) {
+    return NULL;
+  }
+  PyObject *sequence = PySequence_Fast(paths, "paths must be a sequence");
+  if (sequence == NULL) {
+    return NULL;
+  }
+
+  Py_ssize_t count = PySequence_Fast_GET_SIZE(sequence);
+  PyObject *result = NULL;
+  native_path *names = PyMem_Calloc(count ? count : 1, sizeof(native_path));
+  void **handles = PyMem_Calloc(count ? count : 1, sizeof(void *));
+  native_error *errors = PyMem_Calloc(count ? count : 1, sizeof(native_error));
+  double *durations = PyMem_Calloc(count ? count : 1, sizeof(double));
+  if (names == NULL || handles == NULL || errors == NULL || durations == NULL) {
+    PyErr_NoMemory();
+    goto done;
+  }
+  for (Py_ssize_t i = 0; i < count; ++i) {
+    if (!convert_path(PySequence_Fast_GET_ITEM(sequence, i), &names[i])) {
+      goto done;
+    }
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  for (Py_ssize_t i = 0; i < count; ++i) {
+    double start = monotonic_seconds();
+#ifdef _WIN32
+    handles[i] = LoadLibraryExW(names[i], NULL, (DWORD)flags);
+    if (handles[i] == NULL) {
+      errors[i] = GetLastError();
+    }
+#else
+    TRACE_LOAD_START(PyBytes_AS_STRING(names[i]), flags);
+    handles[i] = dlopen(PyBytes_AS_STRING(names[i]), flags);
+    TRACE_LOAD_DONE(PyBytes_AS_STRING(names[i]), handles[i]);
+    if (handles[i] == NULL) {
+      const char *message = dlerror();
+      errors[i] = message ? strdup(message) : NULL;
+    }
+#endif
+    durations[i] = monotonic_seconds() - start;
+  }
+  Py_END_ALLOW_THREADS
+
+  result = PyList_New(count);
+  if (result == NULL) {
+    goto done;
+  }
+  for (Py_ssize_t i = 0; i < count; ++i) {
+    PyObject *entry;
+    if (handles[i] != NULL) {
+      entry = Py_BuildValue("(NOd)", PyLong_FromVoidPtr(handles[i]), Py_None,
+                            durations[i]);
+    } else {
+      entry = Py_BuildValue("(iNd)", 0, error_message(errors[i]), durations[i]);
+    }
+    if (entry == NULL) {
+      Py_CLEAR(result);
+      goto done;
+    }
+    PyList_SET_ITEM(result, i, entry);
+  }
+
+done:
+  for (Py_ssize_t i = 0; i < count; ++i) {
+    if (names != NULL) {
+      free_path(names[i]);
+    }
+#ifndef _WIN32
+    if (errors != NULL) {
+      free(errors[i]);
+    }
+#endif
+  }
+  PyMem_Free(names);
+  PyMem_Free(handles);
+  PyMem_Free(errors);
+  PyMem_Free(durations);
+  Py_DECREF(sequence);
+  return result;
+}
+
+// close(handle, count) -> None
+//
+// Release count references to a library obtained from preload, without holding the
+// GIL since closing the last reference runs the library's destructors.
+static PyObject *close_library(PyObject *self, PyObject *args) {
+  PyObject *handle_object;
+  int count;
+  if (!PyArg_ParseTuple(args, "Oi", &handle_object, &count)) {
+    return NULL;
+  }
+  void *handle = PyLong_AsVoidPtr(handle_object);
+  if (handle == NULL) {
+    if (!PyErr_Occurred()) {
+      PyErr_SetString(PyExc_ValueError, "handle must not be null");
+    }
+    return NULL;
+  }
+  int failed = 0;
+  native_error error = 0;
+  Py_BEGIN_ALLOW_THREADS
+  for (int i = 0; i < count && !failed; ++i) {
+#ifdef _WIN32
+    if (!FreeLibrary((HMODULE)handle)) {
+      failed = 1;
+      error = GetLastError();
+    }
+#else
+    if (dlclose(handle) != 0) {
+      failed = 1;
+      const char *message = dlerror();
+      error = message ? strdup(message) : NULL;
+    }
+#endif
+  }
+  Py_END_ALLOW_THREADS
+  if (!failed) {
+    Py_RETURN_NONE;
+  }
+  PyObject *message = error_message(error);
+#ifndef _WIN32
+  free(error);
+#endif
+  if (message != NULL) {
+    PyErr_SetObject(PyExc_OSError, message);
+    Py_DECREF(message);
+  }
+  return NULL;
+}
+
+// The process-wide registry of loaded libraries. Each interpreter has its own copy of
+// the Python module and its cache, so the registry is what lets a new subinterpreter
+// reuse the libraries that another interpreter already loaded. Entries are keyed like
+// the cache in shared_lib_manager and count the interpreters using them, so that an
+// entry is only removed once the last of them unloads the library. The registry is
+// protected by a statically initialized lock since it is shared by all interpreters.
+typedef struct {
+  char *key;
+  void *handle;
+  int flags;
+  double duration;
+  Py_ssize_t users;
+  // The references opened by interpreters that no longer use the library, which are
+  // closed by the last one.
+  Py_ssize_t orphaned;
+} registry_entry;
+
+static registry_entry *registry = NULL;
+static Py_ssize_t registry_size = 0;
+static Py_ssize_t registry_capacity = 0;
+
+#ifdef _WIN32
+static SRWLOCK registry_mutex = SRWLOCK_INIT;
+static void registry_lock(void) { AcquireSRWLockExclusive(&registry_mutex); }
+static void registry_unlock(void) { ReleaseSRWLockExclusive(&registry_mutex); }
+#else
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void registry_lock(void) { pthread_mutex_lock(&registry_mutex); }
+static void registry_unlock(void) { pthread_mutex_unlock(&registry_mutex); }
+#endif
+
+// Must be called with the registry lock held.
+static registry_entry *registry_find(const char *key) {
+  for (Py_ssize_t i = 0; i < registry_size; ++i) {
+    if (strcmp(registry[i].key, key) == 0) {
+      return &registry[i];
+    }
+  }
+  return NULL;
+}
+
+// lookup(key) -> tuple[int, int, float] | None
+//
+// Get the handle, flags and load time recorded for a library, or None if no
+// interpreter in the process has registered it. The calling interpreter is counted as
+// a user of the library until it releases it.
+static PyObject *lookup(PyObject *self, PyObject *args) {
+  const char *key;
+  if (!PyArg_ParseTuple(args, "s", &key)) {
+    return NULL;
+  }
+  void *handle = NULL;
+  int flags = 0;
+  double duration = 0.0;
+  registry_lock();
+  registry_entry *entry = registry_find(key);
+  if (entry != NULL) {
+    handle = entry->handle;
+    flags = entry->flags;
+    duration = entry->duration;
+    ++entry->users;
+  }
+  registry_unlock();
+  if (handle == NULL) {
+    Py_RETURN_NONE;
+  }
+  return Py_BuildValue("(Nid)", PyLong_FromVoidPtr(handle), flags, duration);
+}
+
+// register(key, handle, flags, duration, opened=True) -> None
+//
+// Record a loaded library, replacing the flags of an existing entry. If opened is
+// true the calling interpreter opened the library itself and is counted as a user.
+static PyObject *register_library(PyObject *self, PyObject *args) {
+  const char *key;
+  PyObject *handle_object;
+  int flags;
+  double duration;
+  int opened = 1;
+  if (!PyArg_ParseTuple(args, "sOid|p", &key, &handle_object, &flags, &duration,
+                        &opened)) {
+    return NULL;
+  }
+  void *handle = PyLong_AsVoidPtr(handle_object);
+  if (handle == NULL) {
+    if (!PyErr_Occurred()) {
+      PyErr_SetString(PyExc_ValueError, "handle must not be null");
+    }
+    return NULL;
+  }
+
+  int out_of_memory = 0;
+  registry_lock();
+  registry_entry *entry = registry_find(key);
+  if (entry != NULL) {
+    entry->flags = flags;
+    entry->users += opened;
+  } else {
+    if (registry_size == registry_capacity) {
+      Py_ssize_t capacity = registry_capacity ? 2 * registry_capacity : 16;
+      registry_entry *grown = realloc(registry, capacity * sizeof(registry_entry));
+      if (grown != NULL) {
+        registry = grown;
+        registry_capacity = capacity;
+      }
+    }
+    char *copy = registry_size < registry_capacity ? strdup(key) : NULL;
+    if (copy == NULL) {
+      out_of_memory = 1;
+    } else {
+      registry[registry_size++] =
+          (registry_entry){copy, handle, flags, duration, 1, 0};
+    }
+  }
+  registry_unlock();
+  if (out_of_memory) {
+    return PyErr_NoMemory();
+  }
+  Py_RETURN_NONE;
+}
+
+// CPU features are reported with the names that Linux uses in /proc/cpuinfo, so that
+// the ctypes fallback can read them from there. The names in these tables must match
+// _CPU_FEATURE_NAMES in shared_lib_manager.py, to which the fallback limits the
+// features it reports.
+typedef struct {
+  const char *name;
+  int word;  // An index into the words read for the platform, see cpu_features.
+  int bit;
+} feature_bit;
+
+#ifdef HAVE_X86_FEATURES
+static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+  __cpuidex((int *)regs, (int)leaf, (int)subleaf);
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long xgetbv0(void) {
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  unsigned int eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+// The words are leaf 1 ECX, leaf 7 EBX, ECX and EDX, and leaf 7 subleaf 1 EAX.
+enum { X86_1_ECX, X86_7_EBX, X86_7_ECX, X86_7_EDX, X86_7_1_EAX, X86_WORDS };
+
+static const feature_bit x86_features[] = {
+    {"pni", X86_1_ECX, 0},
+    {"ssse3", X86_1_ECX, 9},
+    {"fma", X86_1_ECX, 12},
+    {"sse4_1", X86_1_ECX, 19},
+    {"sse4_2", X86_1_ECX, 20},
+    {"popcnt", X86_1_ECX, 23},
+    {"aes", X86_1_ECX, 25},
+    {"avx", X86_1_ECX, 28},
+    {"f16c", X86_1_ECX, 29},
+    {"bmi1", X86_7_EBX, 3},
+    {"avx2", X86_7_EBX, 5},
+    {"bmi2", X86_7_EBX, 8},
+    {"avx512f", X86_7_EBX, 16},
+    {"avx512dq", X86_7_EBX, 17},
+    {"avx512ifma", X86_7_EBX, 21},
+    {"avx512cd", X86_7_EBX, 28},
+    {"avx512bw", X86_7_EBX, 30},
+    {"avx512vl", X86_7_EBX, 31},
+    {"avx512vbmi", X86_7_ECX, 1},
+    {"avx512_vbmi2", X86_7_ECX, 6},
+    {"avx512_vnni", X86_7_ECX, 11},
+    {"avx512_bitalg", X86_7_ECX, 12},
+    {"avx512_vpopcntdq", X86_7_ECX, 14},
+    {"avx512_fp16", X86_7_EDX, 23},
+    {"avx_vnni", X86_7_1_EAX, 4},
+    {"avx512_bf16", X86_7_1_EAX, 5},
+};
+
+static void read_features(unsigned int words[]) {
+  unsigned int regs[4];
+  cpuid(0, 0, regs);
+  unsigned int max_leaf = regs[0];
+  cpuid(1, 0, regs);
+  words[X86_1_ECX] = regs[2];
+  if (max_leaf >= 7) {
+    cpuid(7, 0, regs);
+    words[X86_7_EBX] = regs[1];
+    words[X86_7_ECX] = regs[2];
+    words[X86_7_EDX] = regs[3];
+    if (regs[0] >= 1) {
+      cpuid(7, 1, regs);
+      words[X86_7_1_EAX] = regs[0];
+    }
+  }
+
+  // The AVX registers are only usable if the OS saves them on context switches.
+  unsigned long long xcr0 = (words[X86_1_ECX] >> 27) & 1 ? xgetbv0() : 0;
+  if ((xcr0 & 0x6) != 0x6) {
+    words[X86_1_ECX] &= ~((1u << 12) | (1u << 28) | (1u << 29));
+    words[X86_7_EBX] &= 1u << 3 | 1u << 8;
+    words[X86_7_ECX] = 0;
+    words[X86_7_EDX] = 0;
+    words[X86_7_1_EAX] = 0;
+  } else if ((xcr0 & 0xe0) != 0xe0) {
+    words[X86_7_EBX] &= ~(1u << 16 | 1u << 17 | 1u << 21 | 1u << 28 | 1u << 30 |
+                          1u << 31);
+    words[X86_7_ECX] = 0;
+    words[X86_7_EDX] = 0;
+    words[X86_7_1_EAX] &= ~(1u << 5);
+  }
+}
+
+#define PLATFORM_FEATURES x86_features
+#define PLATFORM_WORDS X86_WORDS
+#elif defined(HAVE_ARM64_FEATURES)
+// The words are AT_HWCAP and AT_HWCAP2 on Linux. NEON is mandatory on arm64, and
+// elsewhere the remaining features are read from sysctl or assumed absent.
+enum { ARM64_HWCAP, ARM64_HWCAP2, ARM64_WORDS };
+
+static const feature_bit arm64_features[] = {
+    {"asimd", ARM64_HWCAP, 1},     {"aes", ARM64_HWCAP, 3},
+    {"atomics", ARM64_HWCAP, 8},   {"fphp", ARM64_HWCAP, 9},
+    {"asimdhp", ARM64_HWCAP, 10},  {"asimddp", ARM64_HWCAP, 20},
+    {"sve", ARM64_HWCAP, 22},      {"sve2", ARM64_HWCAP2, 1},
+    {"i8mm", ARM64_HWCAP2, 13},    {"bf16", ARM64_HWCAP2, 14},
+};
+
+#ifdef __APPLE__
+static int sysctl_flag(const char *name) {
+  int value = 0;
+  size_t size = sizeof(value);
+  return sysctlbyname(name, &value, &size, NULL, 0) == 0 && value;
+}
+#endif
+
+static void read_features(unsigned int words[]) {
+  words[ARM64_HWCAP] = 1u << 1;
+#if defined(__linux__)
+  words[ARM64_HWCAP] = (unsigned int)getauxval(AT_HWCAP);
+  words[ARM64_HWCAP2] = (unsigned int)getauxval(AT_HWCAP2);
+#elif defined(__APPLE__)
+  words[ARM64_HWCAP] |= sysctl_flag("hw.optional.arm.FEAT_AES") << 3 |
+                        sysctl_flag("hw.optional.arm.FEAT_LSE") << 8 |
+                        sysctl_flag("hw.optional.arm.FEAT_FP16") << 9 |
+                        sysctl_flag("hw.optional.arm.FEAT_FP16") << 10 |
+                        sysctl_flag("hw.optional.arm.FEAT_DotProd") << 20;
+  words[ARM64_HWCAP2] = sysctl_flag("hw.optional.arm.FEAT_I8MM") << 13 |
+                        sysctl_flag("hw.optional.arm.FEAT_BF16") << 14;
+#endif
+}
+
+#define PLATFORM_FEATURES arm64_features
+#define PLATFORM_WORDS ARM64_WORDS
+#endif
+
+// cpu_features() -> list[str]
+//
+// Get the names of the instruction set extensions that the CPU and OS support. The
+// list is empty on architectures without known features.
+static PyObject *cpu_features(PyObject *self, PyObject *args) {
+  PyObject *result = PyList_New(0);
+#ifdef PLATFORM_FEATURES
+  unsigned int words[PLATFORM_WORDS] = {0};
+  read_features(words);
+  size_t count = sizeof(PLATFORM_FEATURES) / sizeof(PLATFORM_FEATURES[0]);
+  for (size_t i = 0; result != NULL && i < count; ++i) {
+    const feature_bit *feature = &PLATFORM_FEATURES[i];
+    if ((words[feature->word] >> feature->bit) & 1) {
+      PyObject *name = PyUnicode_FromString(feature->name);
+      if (name == NULL || PyList_Append(result, name) < 0) {
+        Py_CLEAR(result);
+      }
+      Py_XDECREF(name);
+    }
+  }
+#endif
+  return result;
+}
+
+// release(key, references) -> int
+//
+// Stop counting the calling interpreter as a user of a library, handing over the
+// references it opened. Returns the number of references the caller must close, which
+// is zero while other interpreters still use the library.
+static PyObject *release(PyObject *self, PyObject *args) {
+  const char *key;
+  Py_ssize_t references;
+  if (!PyArg_ParseTuple(args, "sn", &key, &references)) {
+    return NULL;
+  }
+  registry_lock();
+  registry_entry *entry = registry_find(key);
+  if (entry != NULL) {
+    entry->orphaned += references;
+    references = 0;
+    if (--entry->users <= 0) {
+      references = entry->orphaned;
+      free(entry->key);
+      *entry = registry[--registry_size];
+    }
+  }
+  registry_unlock();
+  return PyLong_FromSsize_t(references);
+}
+
+#ifdef __APPLE__
+// mapped_memory() -> dict[str, tuple[int, int, int, int]]
+//
+// Get the mapped size and the resident, shared resident and private resident sizes in
+// bytes of the memory mapped to each file in the process.
+static PyObject *mapped_memory(PyObject *self, PyObject *args) {
+  PyObject *result = PyDict_New();
+  if (result == NULL) {
+    return NULL;
+  }
+  pid_t pid = getpid();
+  unsigned long long page_size = (unsigned long long)getpagesize();
+  struct proc_regionwithpathinfo info;
+  uint64_t address = 0;
+  while (proc_pidinfo(pid, PROC_PIDREGIONPATHINFO, address, &info, sizeof(info)) ==
+         (int)sizeof(info)) {
+    struct proc_regioninfo *region = &info.prp_prinfo;
+    address = region->pri_address + region->pri_size;
+    if (info.prp_vip.vip_path[0] == '\0') {
+      continue;
+    }
+    unsigned long long counters[4] = {
+        region->pri_size,
+        region->pri_pages_resident * page_size,
+        region->pri_shared_pages_resident * page_size,
+        region->pri_private_pages_resident * page_size,
+    };
+    PyObject *path = PyUnicode_DecodeFSDefault(info.prp_vip.vip_path);
+    if (path == NULL) {
+      Py_DECREF(result);
+      return NULL;
+    }
+    PyObject *previous = PyDict_GetItemWithError(result, path);
+    if (previous != NULL) {
+      for (int i = 0; i < 4; ++i) {
+        counters[i] += PyLong_AsUnsignedLongLong(PyTuple_GET_ITEM(previous, i));
+      }
+    }
+    PyObject *entry = previous != NULL || !PyErr_Occurred()
+                          ? Py_BuildValue("(KKKK)", counters[0], counters[1],
+                                          counters[2], counters[3])
+                          : NULL;
+    int failed = entry == NULL || PyDict_SetItem(result, path, entry) < 0;
+    Py_XDECREF(entry);
+    Py_DECREF(path);
+    if (failed) {
+      Py_DECREF(result);
+      return NULL;
+    }
+  }
+  return result;
+}
+#endif
+
+#ifndef _WIN32
+// A thread of another interpreter may hold the lock while this process forks, which
+// would leave it locked forever in the child.
+static void registry_fork_prepare(void) { registry_lock(); }
+static void registry_fork_release(void) { registry_unlock(); }
+static pthread_once_t registry_atfork_once = PTHREAD_ONCE_INIT;
+static void registry_register_atfork(void) {
+  pthread_atfork(registry_fork_prepare, registry_fork_release, registry_fork_release);
+}
+#endif
+
+static int _shared_lib_manager_exec(PyObject *module) {
+#ifndef _WIN32
+  pthread_once(&registry_atfork_once, registry_register_atfork);
+#endif
+  return 0;
+}
+
+static PyMethodDef _shared_lib_manager_methods[] = {
+    {"preload", preload, METH_VARARGS,
+     "Open a sequence of libraries with the given flags without holding the GIL."},
+    {"lookup", lookup, METH_VARARGS,
+     "Get the handle, flags and load time registered for a library, or None."},
+    {"register", register_library, METH_VARARGS,
+     "Register a loaded library for all interpreters in the process."},
+    {"release", release, METH_VARARGS,
+     "Release a registered library, returning the number of references to close."},
+    {"close", close_library, METH_VARARGS,
+     "Close references to a library without holding the GIL."},
+    {"cpu_features", cpu_features, METH_NOARGS,
+     "Get the names of the instruction set extensions supported by the CPU."},
+#ifdef __APPLE__
+    {"mapped_memory", mapped_memory, METH_NOARGS,
+     "Get the mapped and resident sizes of the memory mapped to each file."},
+#endif
+    {NULL, NULL, 0, NULL}};
+
+// The module keeps no per-interpreter state and dlerror is thread-local, so it can be
+// imported in isolated subinterpreters and does not need the GIL.
+static PyModuleDef_Slot _shared_lib_manager_slots[] = {
+    {Py_mod_exec, _shared_lib_manager_exec},
+#if PY_VERSION_HEX >= 0x030C0000
+    {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+#ifdef Py_GIL_DISABLED
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, NULL}};
+
+static struct PyModuleDef _shared_lib_manager_module = {
+    PyModuleDef_HEAD_INIT,       "_shared_lib_manager", NULL, 0,
+    _shared_lib_manager_methods, _shared_lib_manager_slots};
+
+PyMODINIT_FUNC PyInit__shared_lib_manager(void) {
+  return PyModuleDef_Init(&_shared_lib_manager_module);
+}
@@ -0,0 +1,47 @@
+# SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION & AFFILIATES.
+# SPDX-License-Identifier: Apache-2.0
+
+"""Build the optional compiled companion module and install the startup hook.
+
+The package metadata lives in pyproject.toml. The extension is optional, so the package
+still installs (and falls back to ctypes) if it cannot be compiled.
+"""
+
+import os
+import sys
+
+from setuptools import Extension, setup
+from setuptools.command.build_py import build_py
+
+# Installed next to the module, where site processes it at every startup.
+STARTUP_HOOK = "shared_lib_manager_preload.pth"
+
+
+class BuildWithStartupHook(build_py):
+    """Add the .pth file that starts preloading to the top level of the build."""
+
+    def run(self) -> None:
+        """Build the module and copy the startup hook next to it."""
+        super().run()
+        self.copy_file(STARTUP_HOOK, os.path.join(self.build_lib, STARTUP_HOOK))
+
+    def get_outputs(self, include_bytecode: bool = True) -> list[str]:  # noqa: FBT001, FBT002
+        """Get the built files, including the startup hook."""
+        return [
+            *super().get_outputs(include_bytecode),
+            os.path.join(self.build_lib, STARTUP_HOOK),
+        ]
+
+
+setup(
+    cmdclass={"build_py": BuildWithStartupHook},
+    ext_modules=[
+        Extension(
+            "_shared_lib_manager",
+            sources=["_shared_lib_manager.c"],
+            # glibc before 2.34 provides dlopen in a separate library.
+            libraries=["dl"] if sys.platform.startswith("linux") else [],
+            optional=True,
+        ),
+    ],
+)
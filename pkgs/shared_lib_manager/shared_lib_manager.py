@@ -5,14 +5,1824 @@
 
 from __future__ import annotations
 
-import ctypes
+import _thread
+import contextlib
+import functools
+import importlib.machinery
 import os
-import platform
+import sys
+import time
+import weakref
+from enum import Enum, auto
 from pathlib import Path
-from typing import TYPE_CHECKING, Callable
+from typing import TYPE_CHECKING, Callable, NamedTuple, TypeVar
 
 if TYPE_CHECKING:
-    from collections.abc import Iterable
+    import concurrent.futures
+    import ctypes
+    import mmap
+    import threading
+    from collections.abc import Iterable, Sequence
+    from importlib.machinery import ModuleSpec
+    from types import ModuleType
+
+
+class LoadMode(Enum):
+    """Mode of the dynamic loader to use when loading the library.
+
+    Only ``LOCAL`` is recommended. The other modes exist to support packages with
+    special requirements and to demonstrate why they should be avoided.
+
+    Attributes
+    ----------
+    LOCAL
+        Load with ``RTLD_LOCAL`` so that the library's symbols are only available to
+        objects that explicitly depend on it.
+    GLOBAL
+        Load with ``RTLD_GLOBAL``, making the library's symbols available to every
+        object loaded afterwards. This can cause symbol collisions between libraries.
+    ENV
+        Do not load anything and instead append the library directories to the
+        loader's search path environment variable (``LD_LIBRARY_PATH``,
+        ``DYLD_LIBRARY_PATH``, or ``PATH``). On Linux and macOS the loader reads this
+        variable at process startup, so this only affects child processes.
+
+    """
+
+    LOCAL = auto()
+    GLOBAL = auto()
+    ENV = auto()
+
+
+class BindingMode(Enum):
+    """When the dynamic loader resolves the undefined symbols of a loaded library.
+
+    Binding modes only apply on Linux and macOS.
+
+    Attributes
+    ----------
+    NOW
+        Resolve all symbols when the library is loaded (``RTLD_NOW``), moving the full
+        relocation cost to load time. This is what ctypes always does.
+    LAZY
+        Resolve function symbols on their first call (``RTLD_LAZY``), which reduces the
+        load time of large libraries when only a few of their functions are used.
+
+    """
+
+    NOW = auto()
+    LAZY = auto()
+
+
+class LibraryStats(NamedTuple):
+    """Statistics about a library loaded by a LibraryLoader.
+
+    Attributes
+    ----------
+    name : str
+        The name of the library in the loader.
+    path : str | None
+        The resolved path of the loaded file, or None if it cannot be determined (for
+        system libraries on macOS).
+    load_time : float
+        The time in seconds spent in the dlopen call that loaded the library. For cache
+        hits this is the time spent by whichever loader first loaded the library.
+    cache_hit : bool
+        Whether the library had already been loaded by another loader in the process.
+    system : bool
+        Whether the system copy of the library was loaded instead of the bundled one.
+    file_size : int | None
+        The size in bytes of the library file, if its path is known.
+    mapped_size : int | None
+        The size in bytes of the process address space mapped to the library file, if
+        available (currently only on Linux).
+
+    """
+
+    name: str
+    path: str | None
+    load_time: float
+    cache_hit: bool
+    system: bool
+    file_size: int | None
+    mapped_size: int | None
+
+
+class LibraryMemory(NamedTuple):
+    """The memory used by the file of a library loaded by a LibraryLoader.
+
+    All sizes are in bytes and cover every mapping of the file in the process. They are
+    None where the platform does not report them: Linux reports all of them from
+    ``/proc/self/smaps``, macOS reports all but ``pss`` and ``shared_clean`` when the
+    compiled companion module is available, and other platforms report none.
+
+    Attributes
+    ----------
+    name : str
+        The name of the library in the loader.
+    path : str | None
+        The resolved path of the loaded file, or None if it cannot be determined.
+    mapped_size : int | None
+        The size of the address space mapped to the file.
+    rss : int | None
+        The size of the resident pages.
+    pss : int | None
+        The proportional set size, which divides each shared page between the
+        processes that have it resident.
+    shared : int | None
+        The size of the resident pages that other processes have resident as well.
+    shared_clean : int | None
+        The size of the shared pages that are unmodified, such as code, which cost
+        nothing for every additional process that maps the library.
+    private : int | None
+        The size of the resident pages that are only resident in this process.
+
+    """
+
+    name: str
+    path: str | None
+    mapped_size: int | None
+    rss: int | None
+    pss: int | None
+    shared: int | None
+    shared_clean: int | None
+    private: int | None
+
+
+class _LoadedLibrary:
+    """A library loaded into the process and the flags it was loaded with.
+
+    The library is held as a raw handle so that loading does not require ctypes. The
+    corresponding ctypes.CDLL is only created when it is requested.
+    """
+
+    __slots__ = (
+        "_cdll",
+        "duration",
+        "flags",
+        "handle",
+        "opens",
+        "path",
+        "refs",
+        "symbols",
+    )
+
+    def __init__(  # noqa: PLR0913
+        self,
+        path: str,
+        handle: int,
+        flags: int,
+        duration: float,
+        cdll: ctypes.CDLL | None = None,
+        opens: int = 1,
+    ):
+        self.path = path
+        self.handle = handle
+        self.flags = flags
+        # The time in seconds spent in the dlopen call that loaded the library.
+        self.duration = duration
+        self._cdll = cdll
+        # The number of references to the library opened by this interpreter, which
+        # are all closed when it is unloaded.
+        self.opens = opens
+        # The number of loaders that have recorded the library, guarded by its lock.
+        self.refs = 0
+        # Prototyped functions looked up in the library, keyed by symbol name, return
+        # type and argument types.
+        self.symbols: dict[tuple, Callable[..., object]] = {}
+
+    @property
+    def cdll(self) -> ctypes.CDLL:
+        """The ctypes.CDLL wrapping the handle, created on first access."""
+        if self._cdll is None:
+            import ctypes
+
+            self._cdll = ctypes.CDLL(self.path, handle=self.handle)
+        return self._cdll
+
+
+# Process-wide cache of loaded libraries shared by all LibraryLoader instances.
+# Libraries loaded by path are keyed by their fully resolved path, while libraries
+# loaded by bare name (e.g. system libraries when prefer_system is set) are keyed by
+# that name since it is what the dynamic loader matches against the SONAME of already
+# loaded libraries. Holding the handles here keeps the libraries alive for the life of
+# the process.
+_HANDLES: dict[str, _LoadedLibrary] = {}
+
+# The SHA-256 digests of library files, keyed by their resolved paths, as given by the
+# packages shipping them. Identical copies of a library shipped by different packages
+# share a cache key derived from their content, so whichever copy is loaded first is
+# reused for the others instead of mapping the same file contents again.
+_CONTENT_DIGESTS: dict[str, str] = {}
+
+# Locks serializing the opening and promotion of each library, keyed like _HANDLES.
+# Threads loading the same library wait for the first one to finish instead of opening
+# the library again, while different libraries are opened concurrently. The locks are
+# never removed, so a lock obtained for a key is the only one for that key.
+_LOAD_LOCKS: dict[str, _thread.LockType] = {}
+
+
+def _load_lock(key: str) -> _thread.LockType:
+    """Get the lock serializing loads of the library with the given cache key."""
+    lock = _LOAD_LOCKS.get(key)
+    if lock is None:
+        # setdefault is atomic, so racing threads agree on a single lock.
+        lock = _LOAD_LOCKS.setdefault(key, _thread.allocate_lock())
+    return lock
+
+
+def _registered(key: str, library_path: str) -> _LoadedLibrary | None:
+    """Adopt a library that another interpreter in the process has already loaded.
+
+    Each interpreter has its own _HANDLES, so the native companion module keeps a
+    registry shared by all of them. Without it a new interpreter opens its libraries
+    again, which only costs the dynamic loader a reference count increment. Must be
+    called with the lock of the key held.
+    """
+    if _native is None:
+        return None
+    registered = _native.lookup(key)
+    if registered is None:
+        return None
+    handle, flags, duration = registered
+    loaded = _HANDLES[key] = _LoadedLibrary(
+        library_path, handle, flags, duration, opens=0
+    )
+    return loaded
+
+
+def _register(key: str, loaded: _LoadedLibrary, *, opened: bool = True) -> None:
+    """Record a loaded library for all interpreters in the process, see _registered.
+
+    ``opened`` is False when an already registered library was only promoted.
+    """
+    if _native is not None:
+        _native.register(key, loaded.handle, loaded.flags, loaded.duration, opened)
+
+
+def _reset_locks_after_fork() -> None:
+    """Replace the locks after a fork, since threads holding them do not survive it.
+
+    Everything else is inherited as is: libraries loaded before the fork stay loaded
+    in the child, and the cached handles keep later loads of them free. Loads that
+    another thread had in progress in the parent are simply done again when needed.
+    """
+    global _LOAD_LOCKS  # noqa: PLW0603
+    _LOAD_LOCKS = {}
+    _ResolutionCache._lock = _thread.allocate_lock()  # noqa: SLF001
+    _LazyLoadFinder._lock = _thread.allocate_lock()  # noqa: SLF001
+    for loader in list(_LOADERS):
+        loader._handles_lock = _thread.allocate_lock()  # noqa: SLF001
+
+
+if hasattr(os, "register_at_fork"):
+    os.register_at_fork(after_in_child=_reset_locks_after_fork)
+
+
+#: The name of the manifest file describing the libraries shipped by a package. It is
+#: placed next to the package's __init__.py so that shared_lib_consumer can load the
+#: libraries without importing the package. See LibraryLoader.from_manifest.
+MANIFEST_NAME = "shared_libs.json"
+
+# Loaders created from manifests, keyed by the resolved path of the manifest.
+_MANIFEST_LOADERS: dict[str, LibraryLoader] = {}
+
+# Flags that change the state of an already loaded library when it is opened again.
+_PROMOTING_FLAGS = (
+    getattr(os, "RTLD_NOW", 0)
+    | getattr(os, "RTLD_GLOBAL", 0)
+    | getattr(os, "RTLD_NODELETE", 0)
+)
+
+
+# The default maximum number of threads used for parallel loads.
+_DEFAULT_MAX_WORKERS = min(8, os.cpu_count() or 1)
+
+# The total size of the library files below which parallel loads are done serially.
+# Opening small libraries takes a few tens of microseconds each once they are in the
+# page cache, less than handing them to worker threads costs, and the loader's lock
+# serializes most of the work anyway.
+_PARALLEL_MIN_SIZE = 16 * 1024 * 1024
+
+# The optional compiled companion module, which opens libraries without ctypes. It may
+# be disabled with an environment variable to exercise the ctypes fallback.
+if os.getenv("SHARED_LIB_MANAGER_DISABLE_NATIVE", "false").lower() in ("false", "0"):
+    try:
+        import _shared_lib_manager as _native
+    except ImportError:
+        _native = None
+else:
+    _native = None
+
+# Windows LoadLibraryExW flags. DEFAULT_DIRS combines the application directory, the
+# directories added with AddDllDirectory and System32.
+_LOAD_LIBRARY_SEARCH_DLL_LOAD_DIR = 0x00000100
+_LOAD_LIBRARY_SEARCH_DEFAULT_DIRS = 0x00001000
+
+# Library directories registered with AddDllDirectory, mapped to the objects returned
+# by os.add_dll_directory. They stay registered for the life of the process.
+_DLL_DIRECTORIES: dict[str, object] = {}
+
+_libdl: ctypes.CDLL | None = None
+_kernel32: ctypes.WinDLL | None = None
+
+
+def _get_libdl() -> ctypes.CDLL:
+    """Get the library providing dlopen, which is libc on all modern platforms."""
+    global _libdl  # noqa: PLW0603
+    if _libdl is None:
+        import ctypes
+
+        libdl = ctypes.CDLL(None)
+        if not hasattr(libdl, "dlopen"):
+            # glibc before 2.34 ships dlopen in a separate library.
+            libdl = ctypes.CDLL("libdl.so.2")
+        libdl.dlopen.argtypes = (ctypes.c_char_p, ctypes.c_int)
+        libdl.dlopen.restype = ctypes.c_void_p
+        libdl.dlerror.argtypes = ()
+        libdl.dlerror.restype = ctypes.c_char_p
+        libdl.dlclose.argtypes = (ctypes.c_void_p,)
+        libdl.dlclose.restype = ctypes.c_int
+        _libdl = libdl
+    return _libdl
+
+
+def _get_kernel32() -> ctypes.WinDLL:
+    """Get kernel32 with LoadLibraryExW and FreeLibrary prototyped, for loading."""
+    global _kernel32  # noqa: PLW0603
+    if _kernel32 is None:
+        import ctypes
+        from ctypes import wintypes
+
+        kernel32 = ctypes.WinDLL("kernel32", use_last_error=True)
+        kernel32.LoadLibraryExW.argtypes = (
+            wintypes.LPCWSTR,
+            wintypes.HANDLE,
+            wintypes.DWORD,
+        )
+        kernel32.LoadLibraryExW.restype = ctypes.c_void_p
+        kernel32.FreeLibrary.argtypes = (wintypes.HMODULE,)
+        kernel32.FreeLibrary.restype = wintypes.BOOL
+        _kernel32 = kernel32
+    return _kernel32
+
+
+def _native_flags(library_path: str, flags: int) -> int:
+    """Get the flags to pass to the native loader for the given path."""
+    if os.name != "nt":
+        return flags
+    # Dependencies of a library loaded by path are searched for in its own directory
+    # and the registered library directories, without probing PATH (LoadLibraryExW
+    # rejects DLL_LOAD_DIR for relative paths).
+    if os.path.isabs(library_path):
+        return _LOAD_LIBRARY_SEARCH_DEFAULT_DIRS | _LOAD_LIBRARY_SEARCH_DLL_LOAD_DIR
+    # Lookups by name are system lookups, which use the standard search order, so that
+    # libraries on PATH are found as they are by other programs. That order does not
+    # include the registered library directories, so bundled copies are not found.
+    return 0
+
+
+def _add_dll_directories(library_paths: Iterable[str]) -> None:
+    """Register the directories of libraries with AddDllDirectory on Windows.
+
+    Each directory is registered once per process, after which libraries in any of
+    the registered directories resolve dependencies on each other directly instead of
+    through the default search order, which probes many directories.
+    """
+    if os.name != "nt":
+        return
+    for library_path in library_paths:
+        if not os.path.isabs(library_path):
+            continue
+        directory = os.path.dirname(library_path)
+        if directory not in _DLL_DIRECTORIES:
+            # Failing to register only loses the optimization.
+            with contextlib.suppress(OSError):
+                _DLL_DIRECTORIES.setdefault(
+                    directory,
+                    os.add_dll_directory(directory),  # type: ignore[attr-defined]
+                )
+
+
+def _prepare_fallback() -> None:
+    """Perform the one-time ctypes setup of the fallback loader.
+
+    This keeps the setup out of the measured load times.
+    """
+    if os.name == "nt":
+        _get_kernel32()
+    else:
+        _get_libdl()
+
+
+def _dlopen_many(
+    library_paths: Sequence[str], flags: int
+) -> list[tuple[int | OSError, float]]:
+    """Open several libraries with exactly the given dlopen flags, in order.
+
+    With the native companion module all libraries are opened in a single call that
+    releases the GIL. Otherwise each library is opened via ctypes.
+
+    Returns
+    -------
+    list[tuple[int | OSError, float]]
+        The handle of each library, or the error raised when opening it, and the time
+        in seconds spent opening it.
+
+    """
+    if _native is not None:
+        if os.name == "nt":
+            # The flags depend on the path, so group the paths by their flags.
+            results: list[tuple[int | OSError, float]] = [(0, 0.0)] * len(
+                library_paths
+            )
+            groups: dict[int, list[int]] = {}
+            for i, library_path in enumerate(library_paths):
+                groups.setdefault(_native_flags(library_path, flags), []).append(i)
+            for group_flags, indices in groups.items():
+                statuses = _native.preload(
+                    [library_paths[i] for i in indices], group_flags
+                )
+                for i, (handle, error, duration) in zip(indices, statuses):
+                    results[i] = (handle or OSError(error), duration)
+            return results
+        return [
+            (handle or OSError(error), duration)
+            for handle, error, duration in _native.preload(library_paths, flags)
+        ]
+
+    _prepare_fallback()
+    results = []
+    for library_path in library_paths:
+        start = time.perf_counter()
+        try:
+            handle: int | OSError = _dlopen(library_path, flags)
+        except OSError as e:
+            handle = e
+        results.append((handle, time.perf_counter() - start))
+    return results
+
+
+def _dlopen(library_path: str, flags: int) -> int:
+    """Open a library with exactly the given dlopen flags and return its handle.
+
+    The native companion module is used if it is available. Otherwise dlopen or
+    LoadLibraryExW is called through ctypes rather than via ctypes.CDLL for several
+    reasons: CDLL always adds RTLD_NOW to the flags, which prevents lazy binding, it
+    holds the GIL for the duration of the call, which prevents other threads from
+    running while large libraries are loaded, and constructing it for every library
+    adds up.
+    """
+    if _native is not None:
+        ((handle, error, _),) = _native.preload(
+            (library_path,), _native_flags(library_path, flags)
+        )
+        if not handle:
+            raise OSError(error)
+        return handle
+    if os.name == "nt":
+        import ctypes
+
+        handle = _get_kernel32().LoadLibraryExW(
+            library_path, None, _native_flags(library_path, flags)
+        )
+        if not handle:
+            raise ctypes.WinError(ctypes.get_last_error())
+        return handle
+    libdl = _get_libdl()
+    handle = libdl.dlopen(os.fsencode(library_path), flags)
+    if not handle:
+        error = libdl.dlerror()
+        raise OSError(error.decode(errors="replace") if error else library_path)
+    return handle
+
+
+def _dlclose(handle: int, count: int) -> None:
+    """Close the given number of references to a library opened by _dlopen."""
+    if count <= 0:
+        return
+    if _native is not None:
+        _native.close(handle, count)
+        return
+    import ctypes
+
+    for _ in range(count):
+        if os.name == "nt":
+            if not _get_kernel32().FreeLibrary(handle):
+                raise ctypes.WinError(ctypes.get_last_error())
+        elif _get_libdl().dlclose(handle) != 0:
+            error = _get_libdl().dlerror()
+            raise OSError(error.decode(errors="replace") if error else "dlclose failed")
+
+
+# Flags of libraries that are never unloaded: other libraries may have bound to the
+# symbols of RTLD_GLOBAL libraries without depending on them, and RTLD_NODELETE
+# libraries stay mapped anyway.
+_UNLOAD_BLOCKING_FLAGS = getattr(os, "RTLD_GLOBAL", 0) | getattr(os, "RTLD_NODELETE", 0)
+
+
+def _drop_python_references(loaded: _LoadedLibrary) -> bool:
+    """Drop the cached ctypes objects of a library if nothing else refers to them.
+
+    Functions obtained from the library keep its CDLL alive, so the library is only
+    safe to close if the CDLL is collected once the cache lets go of it. Otherwise the
+    CDLL is kept and the function cache starts over.
+    """
+    if loaded._cdll is None:  # noqa: SLF001
+        return True
+    import gc
+
+    cdll = weakref.ref(loaded._cdll)  # noqa: SLF001
+    loaded._cdll = None  # noqa: SLF001
+    loaded.symbols = {}
+    # ctypes functions take part in reference cycles, so they are only freed by a
+    # collection.
+    gc.collect()
+    loaded._cdll = cdll()  # noqa: SLF001
+    return loaded._cdll is None  # noqa: SLF001
+
+
+def _release(loaded: _LoadedLibrary) -> bool:
+    """Drop a loader's reference to a library, unloading it after the last one.
+
+    Returns
+    -------
+    bool
+        Whether the library was closed.
+
+    """
+    key = LibraryLoader._cache_key(loaded.path)  # noqa: SLF001
+    with _load_lock(key):
+        loaded.refs -= 1
+        if (
+            loaded.refs > 0
+            or loaded.flags & _UNLOAD_BLOCKING_FLAGS
+            or _HANDLES.get(key) is not loaded
+            or not _drop_python_references(loaded)
+        ):
+            return False
+        del _HANDLES[key]
+        opens = (
+            _native.release(key, loaded.opens) if _native is not None else loaded.opens
+        )
+        _dlclose(loaded.handle, opens)
+        return opens > 0
+
+
+def _loaded_path(loaded: _LoadedLibrary) -> str | None:
+    """Determine the resolved path of the file backing a loaded library.
+
+    Libraries loaded by path already know it, while for libraries loaded by name the
+    path is queried from the dynamic loader where the platform supports it.
+    """
+    if os.path.isabs(loaded.path):
+        return os.path.realpath(loaded.path)
+
+    import ctypes
+
+    if os.name == "nt":
+        buffer = ctypes.create_unicode_buffer(32768)
+        length = ctypes.windll.kernel32.GetModuleFileNameW(
+            ctypes.c_void_p(loaded.handle), buffer, len(buffer)
+        )
+        return os.path.realpath(buffer.value) if length else None
+    if sys.platform.startswith("linux"):
+        # dlinfo(RTLD_DI_LINKMAP) provides the link_map entry of the library, whose
+        # second member is its path.
+        class LinkMap(ctypes.Structure):
+            _fields_ = (("l_addr", ctypes.c_void_p), ("l_name", ctypes.c_char_p))
+
+        libdl = _get_libdl()
+        link_map = ctypes.POINTER(LinkMap)()
+        rtld_di_linkmap = 2
+        if libdl.dlinfo(
+            ctypes.c_void_p(loaded.handle), rtld_di_linkmap, ctypes.byref(link_map)
+        ):
+            return None
+        name = link_map.contents.l_name
+        return os.path.realpath(os.fsdecode(name)) if name else None
+    return None
+
+
+# The size of the reads used to prefetch library files where the OS cannot be asked to
+# read them ahead.
+_WARMUP_CHUNK_SIZE = 1 << 20
+
+
+def _warmup_files(paths: Iterable[str]) -> None:
+    """Read files into the page cache ahead of them being mapped by the loader.
+
+    Where available, posix_fadvise(POSIX_FADV_WILLNEED) makes the kernel read the
+    whole file with large sequential requests in the background. Elsewhere the file is
+    read sequentially in large chunks, which has the same effect on the page cache.
+    Errors are ignored since warming up is purely an optimization.
+    """
+    buffer = None
+    for path in paths:
+        try:
+            if hasattr(os, "posix_fadvise"):
+                fd = os.open(path, os.O_RDONLY)
+                try:
+                    os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_WILLNEED)
+                finally:
+                    os.close(fd)
+            else:
+                if buffer is None:
+                    buffer = bytearray(_WARMUP_CHUNK_SIZE)
+                with Path(path).open("rb", buffering=0) as f:
+                    while f.readinto(buffer):
+                        pass
+        except OSError:
+            pass
+
+
+def _mapped_sizes() -> dict[str, int]:
+    """Get the total size of the address space mapped to each file in the process.
+
+    Only Linux exposes this information cheaply, so the result is empty elsewhere.
+    """
+    sizes: dict[str, int] = {}
+    try:
+        with Path("/proc/self/maps").open() as f:
+            for line in f:
+                fields = line.split(maxsplit=5)
+                if len(fields) == 6 and fields[5].startswith("/"):
+                    start, end = fields[0].split("-")
+                    path = fields[5].rstrip("\n")
+                    sizes[path] = sizes.get(path, 0) + int(end, 16) - int(start, 16)
+    except OSError:
+        pass
+    return sizes
+
+
+# The fields of /proc/self/smaps that are summed for each file, in kB.
+_SMAPS_FIELDS = {
+    "Size": 0,
+    "Rss": 1,
+    "Pss": 2,
+    "Shared_Clean": 3,
+    "Shared_Dirty": 4,
+    "Private_Clean": 5,
+    "Private_Dirty": 6,
+}
+
+
+def _mapped_memory() -> dict[str, tuple[int | None, ...]]:
+    """Get the memory used by each file mapped into the process.
+
+    Returns
+    -------
+    dict[str, tuple[int | None, ...]]
+        The mapped size, RSS, PSS, shared, shared clean and private sizes in bytes of
+        each file, as in LibraryMemory.
+
+    """
+    if _native is not None and hasattr(_native, "mapped_memory"):
+        return {
+            path: (size, rss, None, shared, None, private)
+            for path, (size, rss, shared, private) in _native.mapped_memory().items()
+        }
+    totals: dict[str, list[int]] = {}
+    try:
+        with Path("/proc/self/smaps").open() as f:
+            current = None
+            for line in f:
+                key, _, value = line.partition(":")
+                field = _SMAPS_FIELDS.get(key)
+                if field is not None:
+                    if current is not None:
+                        current[field] += int(value.split()[0]) * 1024
+                elif " " in key:
+                    # The header of the next mapping, whose last column is the file.
+                    fields = line.split(maxsplit=5)
+                    path = fields[5].rstrip("\n") if len(fields) == 6 else ""
+                    current = (
+                        totals.setdefault(path, [0] * len(_SMAPS_FIELDS))
+                        if path.startswith("/")
+                        else None
+                    )
+    except OSError:
+        return {}
+    return {
+        path: (
+            size,
+            rss,
+            pss,
+            shared_clean + shared_dirty,
+            shared_clean,
+            private_clean + private_dirty,
+        )
+        for path, (
+            size,
+            rss,
+            pss,
+            shared_clean,
+            shared_dirty,
+            private_clean,
+            private_dirty,
+        ) in totals.items()
+    }
+
+
+class LibraryInfo(NamedTuple):
+    """The information in the headers of a library file that the loader acts on.
+
+    Attributes
+    ----------
+    file_format : str
+        The format of the file, one of "ELF", "Mach-O" or "PE".
+    soname : str | None
+        The name under which the dynamic loader records the library once it is loaded:
+        the DT_SONAME on Linux, the install name (LC_ID_DYLIB) on macOS and the export
+        name on Windows. None if the library sets none.
+    needed : tuple[str, ...]
+        The names of the libraries this library depends on: the DT_NEEDED entries on
+        Linux, the LC_LOAD_DYLIB (and weak and reexported) entries on macOS, and the
+        imported DLLs on Windows.
+
+    """
+
+    file_format: str
+    soname: str | None
+    needed: tuple[str, ...]
+
+
+def _c_string(data: mmap.mmap, offset: int) -> str:
+    """Read a NUL-terminated string from a mapped file."""
+    end = data.find(b"\0", offset)
+    return os.fsdecode(data[offset : end if end >= 0 else len(data)])
+
+
+def _elf_layout(data: mmap.mmap) -> tuple[int, str]:
+    """Get the class (1 for 32-bit, 2 for 64-bit) and struct byte order of an ELF."""
+    elf_class, encoding = data[4], data[5]
+    if elf_class not in (1, 2) or encoding not in (1, 2):
+        raise ValueError("Unsupported ELF class or data encoding.")
+    return elf_class, "<" if encoding == 1 else ">"
+
+
+def _elf_dynamic(
+    data: mmap.mmap,
+) -> tuple[int, str, list[tuple[int, int]], Callable[[int], int]]:
+    """Read the dynamic section of an ELF file.
+
+    Returns
+    -------
+    tuple[int, str, list[tuple[int, int]], typing.Callable[[int], int]]
+        The class and struct byte order of the file (see :func:`_elf_layout`), the
+        (tag, value) entries of the dynamic section, which are empty if the file has
+        none, and a function mapping virtual addresses to offsets in the file.
+
+    """
+    import struct
+
+    elf_class, order = _elf_layout(data)
+    if elf_class == 2:
+        (phoff,) = struct.unpack_from(f"{order}Q", data, 0x20)
+        phentsize, phnum = struct.unpack_from(f"{order}HH", data, 0x36)
+    else:
+        (phoff,) = struct.unpack_from(f"{order}I", data, 0x1C)
+        phentsize, phnum = struct.unpack_from(f"{order}HH", data, 0x2A)
+
+    # Program headers as (type, offset, virtual address, size in the file).
+    segments = []
+    for index in range(phnum):
+        offset = phoff + index * phentsize
+        if elf_class == 2:
+            p_type, _, p_offset, p_vaddr, _, p_filesz = struct.unpack_from(
+                f"{order}IIQQQQ", data, offset
+            )
+        else:
+            p_type, p_offset, p_vaddr, _, p_filesz = struct.unpack_from(
+                f"{order}IIIII", data, offset
+            )
+        segments.append((p_type, p_offset, p_vaddr, p_filesz))
+
+    pt_load, pt_dynamic = 1, 2
+
+    # Addresses in the dynamic section are mapped back to file offsets through the
+    # loadable segment containing them.
+    def file_offset(address: int) -> int:
+        for p_type, p_offset, p_vaddr, p_filesz in segments:
+            if p_type == pt_load and p_vaddr <= address < p_vaddr + p_filesz:
+                return address - p_vaddr + p_offset
+        raise ValueError(f"Address {address:#x} is not in a loadable segment.")
+
+    entries: list[tuple[int, int]] = []
+    dynamic = next((s for s in segments if s[0] == pt_dynamic), None)
+    if dynamic is None:
+        return elf_class, order, entries, file_offset
+    dt_null = 0
+    entry_format = f"{order}qQ" if elf_class == 2 else f"{order}iI"
+    entry_size = struct.calcsize(entry_format)
+    for offset in range(dynamic[1], dynamic[1] + dynamic[3], entry_size):
+        tag, value = struct.unpack_from(entry_format, data, offset)
+        if tag == dt_null:
+            break
+        entries.append((tag, value))
+    return elf_class, order, entries, file_offset
+
+
+def _read_elf(data: mmap.mmap) -> LibraryInfo:
+    """Read the dynamic section of an ELF file."""
+    _, _, entries, file_offset = _elf_dynamic(data)
+    dt_needed, dt_strtab, dt_soname = 1, 5, 14
+    strtab = None
+    soname = None
+    needed = []
+    for tag, value in entries:
+        if tag == dt_strtab:
+            strtab = value
+        elif tag == dt_soname:
+            soname = value
+        elif tag == dt_needed:
+            needed.append(value)
+    if strtab is None:
+        return LibraryInfo("ELF", None, ())
+
+    try:
+        strtab_offset = file_offset(strtab)
+    except ValueError:
+        raise ValueError("The ELF string table is not in a loadable segment.") from None
+    return LibraryInfo(
+        "ELF",
+        _c_string(data, strtab_offset + soname) if soname is not None else None,
+        tuple(_c_string(data, strtab_offset + name) for name in needed),
+    )
+
+
+def _mach_o_header(data: mmap.mmap, base: int = 0) -> tuple[int, str, int]:
+    """Locate the header of a Mach-O file, or of the first slice of a fat file.
+
+    Returns
+    -------
+    tuple[int, str, int]
+        The offset of the header, the struct byte order and the size of the header,
+        which is 32 for 64-bit files and 28 for 32-bit files.
+
+    """
+    import struct
+
+    (magic,) = struct.unpack_from("<I", data, base)
+    if magic in (0xBEBAFECA, 0xBFBAFECA):
+        # A universal binary, whose header is always big-endian. All slices normally
+        # share the same install name, dependencies and exports, so the first one is
+        # read.
+        (count,) = struct.unpack_from(">I", data, base + 4)
+        if count == 0:
+            raise ValueError("Empty universal binary.")
+        if magic == 0xBEBAFECA:
+            (offset,) = struct.unpack_from(">I", data, base + 16)
+        else:
+            (offset,) = struct.unpack_from(">Q", data, base + 16)
+        return _mach_o_header(data, offset)
+
+    headers = {
+        0xFEEDFACE: ("<", 28),
+        0xFEEDFACF: ("<", 32),
+        0xCEFAEDFE: (">", 28),
+        0xCFFAEDFE: (">", 32),
+    }
+    if magic not in headers:
+        raise ValueError("Unrecognized file format.")
+    return (base, *headers[magic])
+
+
+def _read_mach_o(data: mmap.mmap) -> LibraryInfo:
+    """Read the dylib load commands of a Mach-O file."""
+    import struct
+
+    base, order, header_size = _mach_o_header(data)
+    (ncmds,) = struct.unpack_from(f"{order}I", data, base + 16)
+
+    lc_load_dylib, lc_id_dylib = 0xC, 0xD
+    lc_load_weak_dylib, lc_reexport_dylib = 0x80000018, 0x8000001F
+    soname = None
+    needed = []
+    offset = base + header_size
+    for _ in range(ncmds):
+        cmd, cmdsize, name_offset = struct.unpack_from(f"{order}III", data, offset)
+        if cmd == lc_id_dylib:
+            soname = _c_string(data, offset + name_offset)
+        elif cmd in (lc_load_dylib, lc_load_weak_dylib, lc_reexport_dylib):
+            needed.append(_c_string(data, offset + name_offset))
+        offset += cmdsize
+    return LibraryInfo("Mach-O", soname, tuple(needed))
+
+
+def _pe_directories(data: mmap.mmap) -> tuple[int, int, Callable[[int], int]]:
+    """Locate the export and import directories of a PE file.
+
+    Returns
+    -------
+    tuple[int, int, typing.Callable[[int], int]]
+        The relative virtual addresses of the export and import directories, 0 if the
+        file has none, and a function mapping relative virtual addresses to offsets
+        in the file.
+
+    """
+    import struct
+
+    (pe_offset,) = struct.unpack_from("<I", data, 0x3C)
+    if data[pe_offset : pe_offset + 4] != b"PE\0\0":
+        raise ValueError("Missing PE signature.")
+    coff = pe_offset + 4
+    (section_count,) = struct.unpack_from("<H", data, coff + 2)
+    (optional_size,) = struct.unpack_from("<H", data, coff + 16)
+    optional = coff + 20
+    (magic,) = struct.unpack_from("<H", data, optional)
+    pe32, pe32_plus = 0x10B, 0x20B
+    if magic not in (pe32, pe32_plus):
+        raise ValueError("Unsupported PE optional header.")
+    directories = optional + (96 if magic == pe32 else 112)
+    export_rva, _, import_rva, _ = struct.unpack_from("<IIII", data, directories)
+
+    sections = []
+    for index in range(section_count):
+        virtual_size, virtual_address, raw_size, raw_offset = struct.unpack_from(
+            "<IIII", data, optional + optional_size + index * 40 + 8
+        )
+        sections.append((virtual_address, max(virtual_size, raw_size), raw_offset))
+
+    def file_offset(rva: int) -> int:
+        for virtual_address, size, raw_offset in sections:
+            if virtual_address <= rva < virtual_address + size:
+                return rva - virtual_address + raw_offset
+        raise ValueError(f"RVA {rva:#x} is not in any section.")
+
+    return export_rva, import_rva, file_offset
+
+
+def _read_pe(data: mmap.mmap) -> LibraryInfo:
+    """Read the export name and import directory of a PE file."""
+    import struct
+
+    export_rva, import_rva, file_offset = _pe_directories(data)
+    soname = None
+    if export_rva:
+        (name_rva,) = struct.unpack_from("<I", data, file_offset(export_rva) + 12)
+        soname = _c_string(data, file_offset(name_rva))
+    needed = []
+    if import_rva:
+        offset = file_offset(import_rva)
+        while True:
+            lookup, _, _, name_rva, thunk = struct.unpack_from("<IIIII", data, offset)
+            if not (lookup or name_rva or thunk):
+                break
+            needed.append(_c_string(data, file_offset(name_rva)))
+            offset += 20
+    return LibraryInfo("PE", soname, tuple(needed))
+
+
+def read_library_info(path: os.PathLike | str) -> LibraryInfo:
+    """Read the loader-relevant headers of a library without loading it.
+
+    The file is memory mapped and only the headers and tables that are needed are
+    read, so this is cheap even for very large libraries. ELF, Mach-O (including
+    universal binaries) and PE files are supported regardless of the current platform.
+
+    Parameters
+    ----------
+    path : os.PathLike | str
+        The path to the library.
+
+    Returns
+    -------
+    LibraryInfo
+        The name and dependencies recorded in the library.
+
+    Raises
+    ------
+    ValueError
+        If the file is not a supported library or its headers are malformed.
+
+    """
+    return _parse_library(path, _read_elf, _read_mach_o, _read_pe)
+
+
+_Parsed = TypeVar("_Parsed")
+
+
+def _parse_library(
+    path: os.PathLike | str,
+    read_elf: Callable[[mmap.mmap], _Parsed],
+    read_mach_o: Callable[[mmap.mmap], _Parsed],
+    read_pe: Callable[[mmap.mmap], _Parsed],
+) -> _Parsed:
+    """Map a library file and parse it with the reader for its format.
+
+    Raises
+    ------
+    ValueError
+        If the file is not a supported library or its headers are malformed.
+
+    """
+    import mmap
+    import struct
+
+    with Path(path).open("rb") as f:
+        try:
+            data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        except ValueError:
+            raise ValueError(f"{path} is empty.") from None
+    with data:
+        magic = data[:4]
+        try:
+            if magic == b"\x7fELF":
+                return read_elf(data)
+            if magic[:2] == b"MZ":
+                return read_pe(data)
+            return read_mach_o(data)
+        except (ValueError, IndexError, struct.error) as e:
+            raise ValueError(f"{path} is not a supported library: {e}") from None
+
+
+class LibrarySymbols(NamedTuple):
+    """The dynamic symbols of a library file.
+
+    Attributes
+    ----------
+    defined : frozenset[str]
+        The names of the symbols that the library exports to other libraries, except
+        for weak definitions. Mach-O names are given without the leading underscore
+        that the compiler adds.
+    weak : frozenset[str]
+        The names of the exported weak definitions, such as C++ inline functions and
+        type information, which are expected to be defined by many libraries.
+    undefined : frozenset[str]
+        The names of the symbols that the library leaves for the dynamic loader to
+        resolve from any loaded library. Only ELF libraries resolve symbols this way,
+        since Mach-O (with two-level namespaces) and PE libraries bind each imported
+        symbol to a specific library, so this is empty for other formats.
+
+    """
+
+    defined: frozenset[str]
+    weak: frozenset[str]
+    undefined: frozenset[str]
+
+
+def _table_strings(table: bytes, offsets: list[int]) -> frozenset[str]:
+    """Read NUL-terminated strings at the given offsets of a string table."""
+    if table.isascii():
+        # Decoding the whole table once keeps the offsets valid and is much faster
+        # than decoding each string separately.
+        text = table.decode("ascii")
+        return frozenset([text[offset : text.find("\0", offset)] for offset in offsets])
+    return frozenset(
+        table[offset : table.find(b"\0", offset)].decode(errors="replace")
+        for offset in offsets
+    )
+
+
+# The st_info values of ELF symbols that other libraries can bind to: global symbols,
+# and separately weak and GNU unique ones, that are not section or file symbols.
+# Together with the default or protected visibility in st_other, this decides whether
+# a defined symbol is exported. Precomputing the sets keeps the checks over many
+# symbols cheap.
+_ELF_EXPORTED_INFO = frozenset(
+    info for info in range(256) if info >> 4 == 1 and info & 0xF not in (3, 4)
+)
+_ELF_WEAK_INFO = frozenset(
+    info for info in range(256) if info >> 4 in (2, 10) and info & 0xF not in (3, 4)
+)
+_ELF_EXPORTED_OTHER = frozenset(other for other in range(256) if other & 0x3 in (0, 3))
+# Symbols that the linker defines in every library, which never conflict.
+_ELF_LINKER_SYMBOLS = frozenset(("_init", "_fini", "_edata", "_end", "__bss_start"))
+# The st_info values of global symbols, the only undefined symbols that must resolve.
+_ELF_GLOBAL_INFO = frozenset(info for info in range(256) if info >> 4 == 1)
+
+
+def _elf_symbols(data: mmap.mmap) -> LibrarySymbols:
+    """Read the dynamic symbol table of an ELF file."""
+    import struct
+
+    elf_class, order = _elf_layout(data)
+    # The symbol formats only unpack st_name, st_info, st_other and st_shndx, in that
+    # order, and skip st_value and st_size.
+    if elf_class == 2:
+        (shoff,) = struct.unpack_from(f"{order}Q", data, 0x28)
+        shentsize, shnum = struct.unpack_from(f"{order}HH", data, 0x3A)
+        section_format = f"{order}IIQQQQII"
+        symbol_format = f"{order}IBBH16x"
+    else:
+        (shoff,) = struct.unpack_from(f"{order}I", data, 0x20)
+        shentsize, shnum = struct.unpack_from(f"{order}HH", data, 0x2E)
+        section_format = f"{order}IIIIIIII"
+        symbol_format = f"{order}I8xBBH"
+
+    # Section headers as (type, offset, size, link).
+    sections = []
+    for index in range(shnum):
+        _, sh_type, _, _, sh_offset, sh_size, sh_link, _ = struct.unpack_from(
+            section_format, data, shoff + index * shentsize
+        )
+        sections.append((sh_type, sh_offset, sh_size, sh_link))
+    sht_dynsym = 11
+    dynsym = next((s for s in sections if s[0] == sht_dynsym), None)
+    if dynsym is None:
+        return LibrarySymbols(frozenset(), frozenset(), frozenset())
+    _, strtab_offset, strtab_size, _ = sections[dynsym[3]]
+    strtab = data[strtab_offset : strtab_offset + strtab_size]
+
+    entry_size = struct.calcsize(symbol_format)
+    table = data[dynsym[1] : dynsym[1] + dynsym[2] - dynsym[2] % entry_size]
+    symbols = list(struct.iter_unpack(symbol_format, table))
+    # The null symbol and other unnamed symbols are skipped, as are undefined
+    # (SHN_UNDEF) symbols that are not global.
+    return LibrarySymbols(
+        _table_strings(
+            strtab,
+            [
+                name
+                for name, info, other, shndx in symbols
+                if name
+                and shndx
+                and info in _ELF_EXPORTED_INFO
+                and other in _ELF_EXPORTED_OTHER
+            ],
+        )
+        - _ELF_LINKER_SYMBOLS,
+        _table_strings(
+            strtab,
+            [
+                name
+                for name, info, other, shndx in symbols
+                if name
+                and shndx
+                and info in _ELF_WEAK_INFO
+                and other in _ELF_EXPORTED_OTHER
+            ],
+        ),
+        _table_strings(
+            strtab,
+            [
+                name
+                for name, info, _, shndx in symbols
+                if name and not shndx and info in _ELF_GLOBAL_INFO
+            ],
+        ),
+    )
+
+
+def _mach_o_symbols(data: mmap.mmap) -> LibrarySymbols:
+    """Read the external symbols defined in the symbol table of a Mach-O file."""
+    import struct
+
+    base, order, header_size = _mach_o_header(data)
+    (ncmds,) = struct.unpack_from(f"{order}I", data, base + 16)
+    lc_symtab = 0x2
+    offset = base + header_size
+    for _ in range(ncmds):
+        cmd, cmdsize = struct.unpack_from(f"{order}II", data, offset)
+        if cmd == lc_symtab:
+            break
+        offset += cmdsize
+    else:
+        return LibrarySymbols(frozenset(), frozenset(), frozenset())
+    symoff, nsyms, stroff, strsize = struct.unpack_from(
+        f"{order}IIII", data, offset + 8
+    )
+    # n_strx, n_type, n_sect, n_desc, n_value
+    symbol_format = f"{order}IBBHQ" if header_size == 32 else f"{order}IBBHI"
+    entry_size = struct.calcsize(symbol_format)
+    table = data[base + symoff : base + symoff + nsyms * entry_size]
+    strtab = data[base + stroff : base + stroff + strsize]
+    n_stab, n_type, n_ext, n_sect, n_weak_def = 0xE0, 0x0E, 0x01, 0x0E, 0x80
+    defined = []
+    weak = []
+    for name, kind, _, desc, _ in struct.iter_unpack(symbol_format, table):
+        if not kind & n_stab and kind & n_ext and kind & n_type == n_sect:
+            # Skip the leading underscore of C symbol names.
+            offset = name + 1 if strtab[name : name + 1] == b"_" else name
+            (weak if desc & n_weak_def else defined).append(offset)
+    return LibrarySymbols(
+        _table_strings(strtab, defined), _table_strings(strtab, weak), frozenset()
+    )
+
+
+def _pe_symbols(data: mmap.mmap) -> LibrarySymbols:
+    """Read the names in the export directory of a PE file."""
+    import struct
+
+    export_rva, _, file_offset = _pe_directories(data)
+    if not export_rva:
+        return LibrarySymbols(frozenset(), frozenset(), frozenset())
+    count, _, names_rva = struct.unpack_from("<III", data, file_offset(export_rva) + 24)
+    names = struct.unpack_from(f"<{count}I", data, file_offset(names_rva))
+    return LibrarySymbols(
+        frozenset(_c_string(data, file_offset(name)) for name in names),
+        frozenset(),
+        frozenset(),
+    )
+
+
+def read_library_symbols(path: os.PathLike | str) -> LibrarySymbols:
+    """Read the dynamic symbols of a library without loading it.
+
+    Like :func:`read_library_info`, the file is memory mapped and parsed directly,
+    reading only the dynamic symbol table (ELF), the symbol table (Mach-O) or the
+    export directory (PE).
+
+    Parameters
+    ----------
+    path : os.PathLike | str
+        The path to the library.
+
+    Returns
+    -------
+    LibrarySymbols
+        The symbols the library exports and those it expects from other libraries.
+
+    Raises
+    ------
+    ValueError
+        If the file is not a supported library or its headers are malformed.
+
+    """
+    return _parse_library(path, _elf_symbols, _mach_o_symbols, _pe_symbols)
+
+
+class LibraryRelocations(NamedTuple):
+    """The work the dynamic loader does to relocate a library when loading it.
+
+    Most of the time spent loading a large library goes to resolving relocations,
+    particularly those that look up a symbol in every loaded library, so these counts
+    estimate what a build option such as hidden visibility or ``-Bsymbolic-functions``
+    saves. Relocations are only counted for ELF libraries, since Mach-O and PE
+    libraries bind each imported symbol to a specific library.
+
+    Attributes
+    ----------
+    file_format : str
+        The format of the file, one of "ELF", "Mach-O" or "PE".
+    exported : int
+        The number of symbols the library exports, including weak definitions.
+    relative : int | None
+        The number of relocations that need no symbol lookup, such as pointers into
+        the library itself, which only add the address it is loaded at.
+    symbolic : int | None
+        The number of other data relocations, each of which looks up a symbol when
+        the library is loaded.
+    plt : int | None
+        The number of relocations of functions called through the PLT, which are
+        looked up on the first call with lazy binding or when the library is loaded
+        with immediate binding.
+    bind_now : bool | None
+        Whether the library was linked to always bind immediately (``-z now``).
+    gnu_hash : bool | None
+        Whether the library has the GNU hash table, which makes symbol lookups faster
+        than the SysV hash table alone.
+
+    """
+
+    file_format: str
+    exported: int
+    relative: int | None = None
+    symbolic: int | None = None
+    plt: int | None = None
+    bind_now: bool | None = None
+    gnu_hash: bool | None = None
+
+
+def _elf_relocations(data: mmap.mmap) -> LibraryRelocations:
+    """Count the dynamic relocations of an ELF file."""
+    import struct
+
+    elf_class, order, entries, file_offset = _elf_dynamic(data)
+    dynamic = dict(entries)
+    dt_pltrelsz, dt_rela, dt_relasz, dt_rel, dt_relsz = 2, 7, 8, 17, 18
+    dt_pltrel, dt_jmprel, dt_bind_now, dt_flags = 20, 23, 24, 30
+    dt_relrsz, dt_relr = 35, 36
+    dt_gnu_hash, dt_flags_1 = 0x6FFFFEF5, 0x6FFFFFFB
+    df_bind_now, df_1_now = 0x8, 0x1
+    word = "Q" if elf_class == 2 else "I"
+    addend = "q" if elf_class == 2 else "i"
+    symbol_shift = 32 if elf_class == 2 else 8
+
+    def symbols(address: int, size: int, rela: bool) -> list[int]:  # noqa: FBT001
+        """Get the symbol index of each relocation in a table, 0 for none."""
+        entry_format = f"{order}{word}{word}{addend if rela else ''}"
+        size -= size % struct.calcsize(entry_format)
+        if not size:
+            return []
+        offset = file_offset(address)
+        return [
+            info >> symbol_shift
+            for _, info, *_ in struct.iter_unpack(
+                entry_format, data[offset : offset + size]
+            )
+        ]
+
+    plt_start = dynamic.get(dt_jmprel, 0)
+    plt_size = dynamic.get(dt_pltrelsz, 0)
+    plt = symbols(plt_start, plt_size, dynamic.get(dt_pltrel) == dt_rela)
+    relocations = []
+    for table, size_tag in ((dt_rela, dt_relasz), (dt_rel, dt_relsz)):
+        if table not in dynamic:
+            continue
+        start, end = dynamic[table], dynamic[table] + dynamic.get(size_tag, 0)
+        rela = table == dt_rela
+        if plt_size and start <= plt_start and plt_start + plt_size <= end:
+            # Some linkers include the PLT relocations in the range of the others.
+            plt_end = plt_start + plt_size
+            relocations += symbols(start, plt_start - start, rela)
+            relocations += symbols(plt_end, end - plt_end, rela)
+        else:
+            relocations += symbols(start, end - start, rela)
+    relative = relocations.count(0)
+
+    # Each entry of a packed relative relocation table is either an address, or a
+    # bitmap of the words after the last address to relocate, marked by its low bit.
+    relr_size = dynamic.get(dt_relrsz, 0)
+    relr_size -= relr_size % struct.calcsize(word)
+    if dt_relr in dynamic and relr_size:
+        offset = file_offset(dynamic[dt_relr])
+        for (entry,) in struct.iter_unpack(
+            f"{order}{word}", data[offset : offset + relr_size]
+        ):
+            relative += bin(entry >> 1).count("1") if entry & 1 else 1
+
+    library_symbols = _elf_symbols(data)
+    return LibraryRelocations(
+        "ELF",
+        len(library_symbols.defined) + len(library_symbols.weak),
+        relative,
+        len(relocations) - relocations.count(0),
+        len(plt),
+        dt_bind_now in dynamic
+        or bool(dynamic.get(dt_flags, 0) & df_bind_now)
+        or bool(dynamic.get(dt_flags_1, 0) & df_1_now),
+        dt_gnu_hash in dynamic,
+    )
+
+
+def _mach_o_relocations(data: mmap.mmap) -> LibraryRelocations:
+    """Count the exported symbols of a Mach-O file."""
+    library_symbols = _mach_o_symbols(data)
+    return LibraryRelocations(
+        "Mach-O", len(library_symbols.defined) + len(library_symbols.weak)
+    )
+
+
+def _pe_relocations(data: mmap.mmap) -> LibraryRelocations:
+    """Count the exported symbols of a PE file."""
+    return LibraryRelocations("PE", len(_pe_symbols(data).defined))
+
+
+def read_library_relocations(path: os.PathLike | str) -> LibraryRelocations:
+    """Count the relocations and exported symbols of a library without loading it.
+
+    Like :func:`read_library_info`, the file is memory mapped and parsed directly.
+
+    Parameters
+    ----------
+    path : os.PathLike | str
+        The path to the library.
+
+    Returns
+    -------
+    LibraryRelocations
+        The counts of the relocations and symbols that the loader processes.
+
+    Raises
+    ------
+    ValueError
+        If the file is not a supported library or its headers are malformed.
+
+    """
+    return _parse_library(path, _elf_relocations, _mach_o_relocations, _pe_relocations)
+
+
+def _library_issues(path: str, info: LibraryInfo) -> list[str]:
+    """Check that a library is recorded under its file name once loaded.
+
+    Loading a library by path only satisfies other libraries depending on it if the
+    name the loader records it under matches the name they depend on, which is the
+    file name.
+    """
+    file_name = os.path.basename(path)
+    if info.file_format == "PE":
+        if info.soname is not None and info.soname.lower() != file_name.lower():
+            return [f"{path}: export name {info.soname} does not match the file name"]
+        return []
+    kind = "SONAME" if info.file_format == "ELF" else "install name"
+    if info.soname is None:
+        return [f"{path}: no {kind} is set"]
+    if os.path.basename(info.soname) != file_name:
+        return [f"{path}: {kind} {info.soname} does not match the file name"]
+    return []
+
+
+# The platform.system() names of the platforms that can be identified from
+# sys.platform alone, which avoids importing the platform module at startup.
+_PLATFORM_NAMES = {"linux": "Linux", "darwin": "Darwin", "win32": "Windows"}
+
+
+@functools.lru_cache(maxsize=None)
+def _platform_name() -> str:
+    """Get the platform.system() name of the current platform, computed once."""
+    for prefix, name in _PLATFORM_NAMES.items():
+        if sys.platform.startswith(prefix):
+            return name
+    import platform
+
+    return platform.system()
+
+
+# The CPU features that cpu_features reports, named as in /proc/cpuinfo on Linux. These
+# are the features in the tables of the compiled companion module, and detection
+# without it reports no others, so that the same variants are selected either way.
+_CPU_FEATURE_NAMES = frozenset(
+    (
+        # x86
+        "pni",
+        "ssse3",
+        "fma",
+        "sse4_1",
+        "sse4_2",
+        "popcnt",
+        "aes",
+        "avx",
+        "f16c",
+        "bmi1",
+        "avx2",
+        "bmi2",
+        "avx512f",
+        "avx512dq",
+        "avx512ifma",
+        "avx512cd",
+        "avx512bw",
+        "avx512vl",
+        "avx512vbmi",
+        "avx512_vbmi2",
+        "avx512_vnni",
+        "avx512_bitalg",
+        "avx512_vpopcntdq",
+        "avx512_fp16",
+        "avx_vnni",
+        "avx512_bf16",
+        # arm64
+        "asimd",
+        "atomics",
+        "fphp",
+        "asimdhp",
+        "asimddp",
+        "sve",
+        "sve2",
+        "i8mm",
+        "bf16",
+    )
+)
+
+# IsProcessorFeaturePresent constants for the features that Windows reports, by the
+# name the feature has in /proc/cpuinfo on Linux.
+_WINDOWS_CPU_FEATURES = {
+    "pni": 13,
+    "ssse3": 36,
+    "sse4_1": 37,
+    "sse4_2": 38,
+    "avx": 39,
+    "avx2": 40,
+    "avx512f": 41,
+    "asimd": 19,
+    "aes": 30,
+    "atomics": 34,
+    "asimddp": 43,
+    "sve": 46,
+    "sve2": 47,
+}
+
+# The sysctl names of arm64 features on macOS, and the names of the features they imply.
+_DARWIN_ARM64_FEATURES = {
+    "hw.optional.neon": ("asimd",),
+    "hw.optional.arm.FEAT_AES": ("aes",),
+    "hw.optional.arm.FEAT_LSE": ("atomics",),
+    "hw.optional.arm.FEAT_FP16": ("fphp", "asimdhp"),
+    "hw.optional.arm.FEAT_DotProd": ("asimddp",),
+    "hw.optional.arm.FEAT_I8MM": ("i8mm",),
+    "hw.optional.arm.FEAT_BF16": ("bf16",),
+}
+
+# The macOS names of x86 features that differ from their names on Linux.
+_DARWIN_X86_NAMES = {"sse3": "pni", "avx1_0": "avx"}
+
+
+def _sysctl(libc: ctypes.CDLL, name: str) -> bytes | None:
+    """Read the raw value of a sysctl, or None if it does not exist."""
+    import ctypes
+
+    size = ctypes.c_size_t()
+    if libc.sysctlbyname(name.encode(), None, ctypes.byref(size), None, 0) != 0:
+        return None
+    buffer = ctypes.create_string_buffer(size.value)
+    if libc.sysctlbyname(name.encode(), buffer, ctypes.byref(size), None, 0) != 0:
+        return None
+    return buffer.raw[: size.value]
+
+
+def _detect_cpu_features() -> frozenset[str]:
+    """Detect the CPU features without the compiled companion module."""
+    platform_name = _platform_name()
+    if platform_name == "Linux":
+        try:
+            with open("/proc/cpuinfo") as f:  # noqa: PTH123
+                for line in f:
+                    key, sep, value = line.partition(":")
+                    if sep and key.strip() in ("flags", "Features"):
+                        return _CPU_FEATURE_NAMES.intersection(value.split())
+        except OSError:
+            pass
+        return frozenset()
+
+    import ctypes
+
+    if platform_name == "Windows":
+        present = ctypes.windll.kernel32.IsProcessorFeaturePresent
+        return frozenset(
+            name for name, feature in _WINDOWS_CPU_FEATURES.items() if present(feature)
+        )
+    if platform_name == "Darwin":
+        libc = ctypes.CDLL(None)
+        features = set()
+        for name, implied in _DARWIN_ARM64_FEATURES.items():
+            value = _sysctl(libc, name)
+            if value and int.from_bytes(value, sys.byteorder):
+                features.update(implied)
+        for name in ("machdep.cpu.features", "machdep.cpu.leaf7_features"):
+            value = _sysctl(libc, name)
+            for feature in (value or b"").rstrip(b"\0").decode().split():
+                feature = feature.lower().replace(".", "_")  # noqa: PLW2901
+                features.add(_DARWIN_X86_NAMES.get(feature, feature))
+        return _CPU_FEATURE_NAMES.intersection(features)
+    return frozenset()
+
+
+@functools.lru_cache(maxsize=None)
+def cpu_features() -> frozenset[str]:
+    """Get the instruction set extensions supported by the CPU, detected once.
+
+    Features are named as in the flags of ``/proc/cpuinfo`` on Linux, for example
+    ``avx2``, ``avx512f`` or ``sve``, and only the SIMD and related extensions that
+    library builds commonly select on are reported. The compiled companion module
+    detects them with ``cpuid`` on x86 (including whether the OS enables the AVX
+    registers) and ``getauxval`` or ``sysctl`` on arm64. Without it, Linux reads
+    ``/proc/cpuinfo`` and other platforms only report the features their system APIs
+    expose. Setting ``SHARED_LIB_MANAGER_CPU_FEATURES`` to a comma-separated list
+    replaces detection, for example to force a baseline build.
+
+    Returns
+    -------
+    frozenset[str]
+        The names of the supported features.
+
+    """
+    override = os.getenv("SHARED_LIB_MANAGER_CPU_FEATURES")
+    if override is not None:
+        return frozenset(override.replace(",", " ").split())
+    if _native is not None:
+        return frozenset(_native.cpu_features())
+    return _detect_cpu_features()
+
+
+# The directories searched by the dynamic loader for bare library names, besides those
+# listed in the search path variable of each platform.
+_DEFAULT_SEARCH_PATHS = {
+    "Linux": (
+        "/etc/ld.so.cache",
+        "/lib",
+        "/usr/lib",
+        "/lib64",
+        "/usr/lib64",
+        "/usr/local/lib",
+    ),
+    "Darwin": ("/usr/local/lib", "/usr/lib"),
+    "Windows": (),
+}
+_SEARCH_PATH_VARIABLES = {
+    "Linux": ("LD_LIBRARY_PATH",),
+    "Darwin": ("DYLD_LIBRARY_PATH", "DYLD_FALLBACK_LIBRARY_PATH"),
+    "Windows": ("PATH",),
+}
+
+
+class _ResolutionCache:
+    """Persistent record of where system lookups of libraries were resolved.
+
+    Looking a library up by name makes the dynamic loader search its whole search
+    path, which is wasted work on every start when the result is the same each time.
+    The cache remembers the path that the lookup resolved to, or that it failed, so
+    that later processes can open that path directly or skip straight to the bundled
+    copy. Entries are invalidated when the search path variables or the modification
+    times of the searched files and directories change.
+
+    The cache is enabled with the ``SHARED_LIB_MANAGER_RESOLUTION_CACHE`` environment
+    variable, set to either "1" to use the user cache directory or to the directory to
+    store the cache in. One cache file is kept per interpreter prefix, i.e. per
+    environment.
+    """
+
+    _entries: dict[str, dict] | None = None
+    _file: Path | None = None
+    _lock = _thread.allocate_lock()
+
+    @staticmethod
+    @functools.lru_cache(maxsize=None)
+    def _path() -> Path | None:
+        """Get the path of the cache file, or None if the cache is disabled."""
+        setting = os.getenv("SHARED_LIB_MANAGER_RESOLUTION_CACHE", "")
+        if setting.lower() in ("", "0", "false"):
+            return None
+        if setting.lower() not in ("1", "true"):
+            directory = Path(setting)
+        elif os.name == "nt":
+            directory = (
+                Path(os.getenv("LOCALAPPDATA") or Path.home()) / "shared_lib_manager"
+            )
+        else:
+            directory = (
+                Path(os.getenv("XDG_CACHE_HOME") or Path.home() / ".cache")
+                / "shared_lib_manager"
+            )
+        import hashlib
+
+        prefix_hash = hashlib.sha1(os.fsencode(sys.prefix)).hexdigest()[:16]
+        return directory / f"resolutions-{prefix_hash}.json"
+
+    @staticmethod
+    def _search_state(resolved: str | None) -> dict:
+        """Capture the inputs that determine the result of a lookup.
+
+        Parameters
+        ----------
+        resolved : str | None
+            The path the lookup resolved to, if it succeeded.
+
+        """
+        platform_name = _platform_name()
+        variables = {
+            name: os.environ.get(name, "")
+            for name in _SEARCH_PATH_VARIABLES.get(platform_name, ())
+        }
+        candidates = [
+            entry
+            for value in variables.values()
+            for entry in value.split(os.pathsep)
+            if entry
+        ]
+        candidates.extend(_DEFAULT_SEARCH_PATHS.get(platform_name, ()))
+        if resolved is not None:
+            candidates.append(resolved)
+        mtimes: dict[str, int | None] = {}
+        for candidate in candidates:
+            try:
+                mtimes[candidate] = os.stat(candidate).st_mtime_ns
+            except OSError:
+                mtimes[candidate] = None
+        return {"variables": variables, "mtimes": mtimes}
+
+    @classmethod
+    def _load_entries(cls) -> dict[str, dict]:
+        """Read the cache file, once per process."""
+        if cls._entries is None:
+            entries: dict[str, dict] = {}
+            path = cls._path()
+            if path is not None:
+                import json
+
+                with contextlib.suppress(OSError, ValueError):
+                    with path.open() as f:
+                        data = json.load(f)
+                    if data.get("prefix") == sys.prefix:
+                        entries = data["libraries"]
+            # Threads reading the file concurrently must end up sharing one dict.
+            with cls._lock:
+                if cls._entries is None:
+                    cls._entries = entries
+        return cls._entries
+
+    @classmethod
+    def lookup(cls, library_name: str) -> tuple[bool, str | None]:
+        """Get the remembered result of looking up a library by name.
+
+        Parameters
+        ----------
+        library_name : str
+            The file name of the library that is looked up.
+
+        Returns
+        -------
+        tuple[bool, str | None]
+            Whether a valid entry was found, and the path that the lookup resolved to
+            or None if the lookup failed.
+
+        """
+        if cls._path() is None:
+            return False, None
+        entry = cls._load_entries().get(library_name)
+        if entry is None or entry["state"] != cls._search_state(entry["path"]):
+            return False, None
+        return True, entry["path"]
+
+    @classmethod
+    def store(cls, library_name: str, resolved: str | None) -> None:
+        """Remember the result of looking up a library by name.
+
+        Parameters
+        ----------
+        library_name : str
+            The file name of the library that was looked up.
+        resolved : str | None
+            The path that the lookup resolved to, or None if it failed.
+
+        """
+        path = cls._path()
+        if path is None:
+            return
+        entries = cls._load_entries()
+        entry = {"path": resolved, "state": cls._search_state(resolved)}
+        if entries.get(library_name) == entry:
+            return
+        entries[library_name] = entry
+
+        import json
+        import tempfile
+
+        # Write to a temporary file first so that concurrent writers never leave a
+        # partially written cache. Failing to write only loses the optimization.
+        with contextlib.suppress(OSError):
+            path.parent.mkdir(parents=True, exist_ok=True)
+            fd, temporary = tempfile.mkstemp(
+                prefix=f"{path.name}.", suffix=".tmp", dir=path.parent
+            )
+            try:
+                with os.fdopen(fd, "w") as f:
+                    json.dump({"prefix": sys.prefix, "libraries": dict(entries)}, f)
+                os.replace(temporary, path)
+            except OSError:
+                os.unlink(temporary)
+                raise
+
+
+class LibraryVariant:
+    """A build of a library that requires particular CPU features.
+
+    Parameters
+    ----------
+    requires : typing.Iterable[str]
+        The CPU features that the build uses, named as by :func:`cpu_features`.
+    Linux : os.PathLike
+        The path to the build on Linux.
+    Darwin : os.PathLike
+        The path to the build on macOS.
+    Windows : os.PathLike
+        The path to the build on Windows.
+    sha256 : str | None
+        The SHA-256 digest of the build on the current platform, see
+        :class:`PlatformLibrary`.
+
+    Raises
+    ------
+    ValueError
+        If a required feature is not one that :func:`cpu_features` can report, since
+        the variant would then never be loaded.
+
+    """
+
+    __slots__ = ("_paths", "requires", "sha256")
+
+    def __init__(
+        self,
+        requires: Iterable[str],
+        *,
+        Darwin: os.PathLike | str | None = None,  # noqa: N803
+        Linux: os.PathLike | str | None = None,  # noqa: N803
+        Windows: os.PathLike | str | None = None,  # noqa: N803
+        sha256: str | None = None,
+    ):
+        self.requires = frozenset(
+            (requires,) if isinstance(requires, str) else requires
+        )
+        unknown = self.requires - _CPU_FEATURE_NAMES
+        if unknown:
+            raise ValueError(
+                f"Unknown CPU features {', '.join(sorted(unknown))}, the known "
+                f"features are {', '.join(sorted(_CPU_FEATURE_NAMES))}."
+            )
+        self.sha256 = sha256
+        self._paths = {
+            "Darwin": os.fspath(Darwin) if Darwin else None,
+            "Linux": os.fspath(Linux) if Linux else None,
+            "Windows": os.fspath(Windows) if Windows else None,
+        }
+
+    def __repr__(self) -> str:
+        paths = "".join(
+            f", {name}={path!r}"
+            for name, path in self._paths.items()
+            if path is not None
+        )
+        return f"LibraryVariant({sorted(self.requires)!r}{paths})"
 
 
 # Once we require Python 3.10, switch to using a dataclass with kw_only=True
@@ -21,127 +1831,2401 @@ class PlatformLibrary:
 
     Parameters
     ----------
-    Linux : os.PathLike
-        The path to the library on Linux.
-    Darwin : os.PathLike
-        The path to the library on macOS.
-    Windows : os.PathLike
-        The path to the library on Windows.
-    default : typing.Callable[[], os.PathLike]
-        A callable that returns the default path to the library. This is used when the
-        current platform is not found in the library paths. It may also be used by
-        libraries that require a more general key for determining what path to use if
-        the choice needs to be made at runtime based on additional factors.
+    Linux : os.PathLike
+        The path to the library on Linux.
+    Darwin : os.PathLike
+        The path to the library on macOS.
+    Windows : os.PathLike
+        The path to the library on Windows.
+    default : typing.Callable[[], os.PathLike]
+        A callable that returns the default path to the library. This is used when the
+        current platform is not found in the library paths. It may also be used by
+        libraries that require a more general key for determining what path to use if
+        the choice needs to be made at runtime based on additional factors.
+    depends_on : typing.Iterable[str]
+        The names of other libraries in the same LibraryLoader that this library
+        depends on. Dependencies are always loaded before the libraries that depend on
+        them, so that the dynamic loader finds them already loaded instead of
+        searching the filesystem.
+    info : LibraryInfo | None
+        The precomputed headers of the library on the current platform, typically
+        read from a manifest. When given, dependencies on other libraries of the same
+        loader are derived from them, and libraries with the same SONAME are only
+        loaded once by :func:`load_all`, all without reading the file.
+    variants : typing.Iterable[LibraryVariant]
+        Builds of the library optimized for particular CPU features, fastest first.
+        The first variant with a path for the current platform whose requirements are
+        all met by :func:`cpu_features` is loaded instead of the platform path, which
+        remains the baseline build used on CPUs that support none of the variants.
+        Variants are assumed to have the same headers as the baseline build.
+    sha256 : str | None
+        The SHA-256 digest of the library file on the current platform, typically
+        read from a manifest. Libraries with the same digest are only loaded once per
+        process, even when different packages ship copies of them at different paths.
+
+    """
+
+    depends_on: tuple[str, ...]
+    variants: tuple[LibraryVariant, ...]
+
+    def __init__(  # noqa: PLR0913
+        self,
+        *,
+        Darwin: os.PathLike | str | None = None,  # noqa: N803
+        Linux: os.PathLike | str | None = None,  # noqa: N803
+        Windows: os.PathLike | str | None = None,  # noqa: N803
+        default: Callable[[], os.PathLike | str] | None = None,
+        depends_on: Iterable[str] = (),
+        info: LibraryInfo | None = None,
+        variants: Iterable[LibraryVariant] = (),
+        sha256: str | None = None,
+    ):
+        # public attributes should correspond to platform.system() return values:
+        # https://docs.python.org/3/library/platform.html#platform.system
+        # TODO: Determine if sys.platform is more appropriate
+        # https://discuss.python.org/t/clarify-usage-of-platform-system/70900/4
+        if not all(
+            isinstance(path, (os.PathLike, str)) or path is None
+            for path in (Darwin, Linux, Windows)
+        ):
+            raise TypeError("Paths must be instances of pathlib.Path, str, or None.")
+        # The paths are kept as strings and only the one for the current platform is
+        # validated, when it is first needed.
+        self._paths = {
+            "Darwin": os.fspath(Darwin) if Darwin else None,
+            "Linux": os.fspath(Linux) if Linux else None,
+            "Windows": os.fspath(Windows) if Windows else None,
+        }
+        self._resolved: str | None = None
+        self.default = default
+        self.depends_on = (
+            (depends_on,) if isinstance(depends_on, str) else tuple(depends_on)
+        )
+        if not all(isinstance(name, str) for name in self.depends_on):
+            raise TypeError("Dependencies must be library names.")
+        self.info = info
+        self.sha256 = sha256
+        self.variants = tuple(variants)
+        if not all(isinstance(variant, LibraryVariant) for variant in self.variants):
+            raise TypeError("Variants must be instances of LibraryVariant.")
+
+    @property
+    def Darwin(self) -> Path | None:  # noqa: N802
+        """The path to the library on macOS."""
+        path = self._paths["Darwin"]
+        return Path(path) if path is not None else None
+
+    @property
+    def Linux(self) -> Path | None:  # noqa: N802
+        """The path to the library on Linux."""
+        path = self._paths["Linux"]
+        return Path(path) if path is not None else None
+
+    @property
+    def Windows(self) -> Path | None:  # noqa: N802
+        """The path to the library on Windows."""
+        path = self._paths["Windows"]
+        return Path(path) if path is not None else None
+
+    def _resolve(self) -> str | None:
+        """Get the path to the library on the current platform.
+
+        The path is computed on first use and cached. It is the path of the first
+        supported variant, or else the path for the current platform, falling back to
+        the default callable if there is no path for the current platform.
+
+        Returns
+        -------
+        str | None
+            The path to the library, or None if it is not available on the current
+            platform.
+
+        """
+        if self._resolved is None:
+            platform_name = _platform_name()
+            path, digest = next(
+                (
+                    (variant._paths[platform_name], variant.sha256)  # noqa: SLF001
+                    for variant in self.variants
+                    if variant._paths.get(platform_name)  # noqa: SLF001
+                    and variant.requires <= cpu_features()
+                ),
+                (self._paths.get(platform_name), self.sha256),
+            )
+            if path is not None:
+                if not os.path.isabs(path):
+                    raise ValueError("All paths must be absolute.")
+                if digest is not None:
+                    _CONTENT_DIGESTS[os.path.realpath(path)] = digest.lower()
+            elif self.default is not None:
+                path = os.fspath(self.default())
+            self._resolved = path
+        return self._resolved
+
+    def inspect(self) -> LibraryInfo:
+        """Get the headers of the library on the current platform.
+
+        The precomputed headers are returned if available, otherwise they are read
+        from the library file (without loading it) and cached.
+
+        Returns
+        -------
+        LibraryInfo
+            The name and dependencies recorded in the library.
+
+        """
+        if self.info is None:
+            path = self._resolve()
+            if path is None:
+                raise ValueError("No library found for the current platform.")
+            self.info = read_library_info(path)
+        return self.info
+
+
+def _manifest_info(library: dict) -> LibraryInfo | None:
+    """Get the precomputed headers for the current platform from a manifest entry."""
+    info = library.get("info", {}).get(_platform_name())
+    if info is None:
+        return None
+    return LibraryInfo(info["file_format"], info.get("soname"), tuple(info["needed"]))
+
+
+def _dependency_order(
+    dependencies: dict[str, tuple[str, ...]],
+) -> tuple[list[str], dict[str, int]]:
+    """Sort libraries so that every library comes after its dependencies.
+
+    Libraries are otherwise kept in their original order.
+
+    Parameters
+    ----------
+    dependencies : dict[str, tuple[str, ...]]
+        A mapping from each library name to the names of its dependencies.
+
+    Returns
+    -------
+    tuple[list[str], dict[str, int]]
+        The sorted library names, and the level of each library in the dependency
+        graph, where libraries at the same level do not depend on each other.
+
+    """
+    order: list[str] = []
+    levels: dict[str, int] = {}
+    # The libraries currently being visited, used to report the cycle if one is found.
+    stack: list[str] = []
+
+    def visit(name: str) -> int:
+        if name in levels:
+            return levels[name]
+        if name in stack:
+            cycle = " -> ".join((*stack[stack.index(name) :], name))
+            raise ValueError(f"Circular dependency between libraries: {cycle}.")
+        stack.append(name)
+        level = 0
+        for dependency in dependencies[name]:
+            if dependency not in dependencies:
+                raise ValueError(
+                    f"Library {name} depends on unknown library {dependency}."
+                )
+            level = max(level, visit(dependency) + 1)
+        stack.pop()
+        levels[name] = level
+        order.append(name)
+        return level
+
+    for name in dependencies:
+        visit(name)
+    return order, levels
+
+
+class LibraryLoader:
+    """Loader for a set of native libraries associated with a module.
+
+    Parameters
+    ----------
+    libraries : dict[str, PlatformLibrary | tuple[os.PathLike | str, os.PathLike | str, os.PathLike | str]]
+        A mapping from library names to the paths of the libraries on each platform. If
+        a tuple is passed, it must be ordered as (Linux, Darwin, Windows).
+    mode : LoadMode
+        How the libraries are made available to the process. Default is
+        ``LoadMode.LOCAL``, which is the only recommended mode.
+    binding : BindingMode
+        When the loader resolves the symbols of the loaded libraries. Default is
+        ``BindingMode.NOW``.
+    nodelete : bool
+        Whether to load with ``RTLD_NODELETE`` so that the libraries are never unloaded,
+        where the platform supports it. Default is False.
+
+    """  # noqa: E501
+
+    def __init__(
+        self,
+        libraries: dict[str, PlatformLibrary],
+        *,
+        mode: LoadMode = LoadMode.LOCAL,
+        binding: BindingMode = BindingMode.NOW,
+        nodelete: bool = False,
+    ):
+        if not isinstance(mode, LoadMode):
+            raise TypeError(f"Invalid load mode {mode}. Expected a LoadMode.")
+        if not isinstance(binding, BindingMode):
+            raise TypeError(f"Invalid binding mode {binding}. Expected a BindingMode.")
+        self._mode = mode
+        self._flags = (
+            getattr(os, "RTLD_GLOBAL", 0)
+            if mode == LoadMode.GLOBAL
+            else getattr(os, "RTLD_LOCAL", 0)
+        )
+        if os.name != "nt":
+            self._flags |= os.RTLD_LAZY if binding == BindingMode.LAZY else os.RTLD_NOW
+            if nodelete:
+                self._flags |= getattr(os, "RTLD_NODELETE", 0)
+
+        for lib, path in libraries.items():
+            if not isinstance(path, PlatformLibrary):
+                raise TypeError(
+                    f"Invalid path {path} for library {lib}. Expected a tuple or "
+                    "PlatformLibrary."
+                )
+        # The paths for the current platform are only resolved when they are loaded.
+        self._libraries = dict(libraries)
+
+        # The order in which the libraries must be loaded to satisfy their declared
+        # dependencies, and the level of each library in the dependency graph.
+        # Dependencies recorded in precomputed headers are added to the declared ones.
+        sonames = {
+            path.info.soname: lib
+            for lib, path in libraries.items()
+            if path.info is not None and path.info.soname is not None
+        }
+        self._dependencies: dict[str, tuple[str, ...]] = {}
+        for lib, path in libraries.items():
+            dependencies = list(path.depends_on)
+            if path.info is not None:
+                dependencies.extend(
+                    sonames[name]
+                    for name in path.info.needed
+                    if sonames.get(name, lib) != lib
+                )
+            self._dependencies[lib] = tuple(dict.fromkeys(dependencies))
+        self._order, self._levels = _dependency_order(self._dependencies)
+
+        # The handles loaded by this loader, keyed by library name. The lock makes
+        # recording and forgetting a handle atomic, so that concurrent loads of the
+        # same library take a single reference to it.
+        self._handles: dict[str, _LoadedLibrary] = {}
+        self._handles_lock = _thread.allocate_lock()
+        # Whether each library was found in the process-wide cache and whether the
+        # system copy was loaded, keyed by library name.
+        self._load_info: dict[str, tuple[bool, bool]] = {}
+        # The loads started by load_async that have not finished yet, keyed by the
+        # names of the libraries they load. They are not tied to an event loop, so
+        # loads awaited from different loops are shared as well.
+        self._async_loads: dict[str, concurrent.futures.Future] = {}
+
+        _LOADERS.add(self)
+
+        #: The ratio of the summed load times of the individual libraries to the wall
+        #: time of the most recent parallel load, i.e. the speedup relative to loading
+        #: the same libraries serially. None if no parallel load has happened, or if
+        #: the most recent one was done serially since it could not benefit.
+        self.parallel_speedup: float | None = None
+
+    @classmethod
+    def from_manifest(cls, manifest: os.PathLike | str) -> LibraryLoader:
+        """Create a loader from a JSON manifest describing the libraries.
+
+        A manifest holds the same information as the constructor arguments in a form
+        that can be read without running any code from the package shipping the
+        libraries, for example::
+
+            {
+                "mode": "LOCAL",
+                "binding": "NOW",
+                "nodelete": false,
+                "libraries": {
+                    "foo": {
+                        "Linux": "lib/libfoo.so",
+                        "Darwin": "lib/libfoo.dylib",
+                        "Windows": "lib/foo.dll",
+                        "depends_on": [],
+                        "info": {
+                            "Linux": {
+                                "file_format": "ELF",
+                                "soname": "libfoo.so",
+                                "needed": ["libc.so.6"]
+                            }
+                        },
+                        "sha256": {"Linux": "9f86d081884c7d65..."},
+                        "variants": [
+                            {"requires": ["avx2", "fma"], "Linux": "lib/avx2/libfoo.so"}
+                        ]
+                    }
+                }
+            }
+
+        Relative paths are interpreted relative to the directory containing the
+        manifest, and all keys other than "libraries" are optional. The "info" of each
+        library holds its precomputed headers on each platform (see
+        :class:`LibraryInfo`) and "sha256" the digests of its files, as written by
+        ``python -m shared_lib_manager manifest``, and its "variants" list the builds
+        for particular CPU features (see :class:`LibraryVariant`), which may have
+        digests of their own.
+        Since a manifest cannot express a default callable, packages that need one
+        must construct their loader in code instead.
+
+        Parameters
+        ----------
+        manifest : os.PathLike | str
+            The path to the manifest file.
+
+        Returns
+        -------
+        LibraryLoader
+            The loader for the libraries in the manifest. Repeated calls with the same
+            manifest return the same loader.
+
+        """
+        manifest = os.path.realpath(manifest)
+        try:
+            return _MANIFEST_LOADERS[manifest]
+        except KeyError:
+            pass
+
+        import json
+
+        with Path(manifest).open() as f:
+            data = json.load(f)
+        root = os.path.dirname(manifest)
+        platform_name = _platform_name()
+        try:
+            mode = LoadMode[data.get("mode", "LOCAL")]
+            binding = BindingMode[data.get("binding", "NOW")]
+            libraries = {
+                name: PlatformLibrary(
+                    **{
+                        key: os.path.join(root, library[key])
+                        for key in ("Darwin", "Linux", "Windows")
+                        if library.get(key)
+                    },
+                    depends_on=library.get("depends_on", ()),
+                    info=_manifest_info(library),
+                    variants=[
+                        LibraryVariant(
+                            variant["requires"],
+                            **{
+                                key: os.path.join(root, variant[key])
+                                for key in ("Darwin", "Linux", "Windows")
+                                if variant.get(key)
+                            },
+                            sha256=variant.get("sha256", {}).get(platform_name),
+                        )
+                        for variant in library.get("variants", ())
+                    ],
+                    sha256=library.get("sha256", {}).get(platform_name),
+                )
+                for name, library in data["libraries"].items()
+            }
+        except (KeyError, AttributeError, TypeError) as e:
+            raise ValueError(f"Invalid library manifest {manifest}: {e!r}") from None
+        loader = cls(
+            libraries,
+            mode=mode,
+            binding=binding,
+            nodelete=bool(data.get("nodelete", False)),
+        )
+        return _MANIFEST_LOADERS.setdefault(manifest, loader)
+
+    @staticmethod
+    def _cache_key(library_path: str) -> str:
+        """Get the key of a library in the process-wide cache."""
+        if not os.path.isabs(library_path):
+            return library_path
+        library_path = os.path.realpath(library_path)
+        digest = _CONTENT_DIGESTS.get(library_path)
+        return f"sha256:{digest}" if digest is not None else library_path
+
+    @staticmethod
+    def _load(library_path: Path | str, flags: int) -> tuple[_LoadedLibrary, bool]:
+        """Load the library at the given path with the given dlopen flags.
+
+        Libraries that have already been loaded in this process are returned from the
+        process-wide cache without calling into the dynamic loader again, unless the
+        flags request a stronger mode (e.g. RTLD_GLOBAL for a library previously loaded
+        with RTLD_LOCAL), in which case the library is reopened to promote it.
+
+        Returns
+        -------
+        tuple[_LoadedLibrary, bool]
+            The loaded library and whether it was found in the process-wide cache.
+
+        """
+        library_path = str(library_path)
+        key = LibraryLoader._cache_key(library_path)
+        loaded = _HANDLES.get(key)
+        if loaded is None:
+            with _load_lock(key):
+                # Another thread may have loaded the library while this one waited.
+                loaded = _HANDLES.get(key) or _registered(key, library_path)
+                if loaded is None:
+                    if _native is None:
+                        _prepare_fallback()
+                    start = time.perf_counter()
+                    handle = _dlopen(library_path, flags)
+                    loaded = _HANDLES[key] = _LoadedLibrary(
+                        library_path, handle, flags, time.perf_counter() - start
+                    )
+                    _register(key, loaded)
+                    return loaded, False
+        if flags & _PROMOTING_FLAGS & ~loaded.flags:
+            with _load_lock(key):
+                if flags & _PROMOTING_FLAGS & ~loaded.flags:
+                    # The extra reference is owned by the cached handle. The cached
+                    # file is reopened, since the requested path may be an identical
+                    # copy that would otherwise be opened as a separate library.
+                    _dlopen(loaded.path, flags | loaded.flags)
+                    loaded.opens += 1
+                    loaded.flags |= flags
+                    _register(key, loaded, opened=False)
+        return loaded, True
+
+    @staticmethod
+    def _load_many(
+        library_paths: Sequence[str], flags: int
+    ) -> list[tuple[_LoadedLibrary, bool]]:
+        """Load several libraries in order, opening all uncached ones in one batch.
+
+        Returns
+        -------
+        list[tuple[_LoadedLibrary, bool]]
+            The loaded libraries and whether each was found in the process-wide cache.
+
+        Raises
+        ------
+        OSError
+            The first error encountered. All libraries that could be loaded are still
+            added to the process-wide cache.
+
+        """
+        missing = {}
+        for library_path in library_paths:
+            key = LibraryLoader._cache_key(library_path)
+            if key not in _HANDLES and key not in missing:
+                missing[key] = library_path
+        error = None
+        opened = set()
+        # The locks of the whole batch are held while it is opened. They are always
+        # acquired in sorted order so that overlapping batches cannot deadlock.
+        locks = [_load_lock(key) for key in sorted(missing)]
+        for lock in locks:
+            lock.acquire()
+        try:
+            missing = {
+                key: library_path
+                for key, library_path in missing.items()
+                if key not in _HANDLES and _registered(key, library_path) is None
+            }
+            if missing:
+                results = _dlopen_many(list(missing.values()), flags)
+                for (key, library_path), (result, duration) in zip(
+                    missing.items(), results
+                ):
+                    if isinstance(result, OSError):
+                        error = error or result
+                    else:
+                        loaded = _HANDLES[key] = _LoadedLibrary(
+                            library_path, result, flags, duration
+                        )
+                        _register(key, loaded)
+                        opened.add(library_path)
+        finally:
+            for lock in locks:
+                lock.release()
+        if error is not None:
+            raise error
+        # Cache hits might need to be promoted, which _load takes care of.
+        return [
+            (LibraryLoader._load(library_path, flags)[0], library_path not in opened)
+            for library_path in library_paths
+        ]
+
+    def _library_path(self, library_name: str) -> str:
+        """Get the path to a library on the current platform."""
+        path = self._libraries[library_name]._resolve()  # noqa: SLF001
+        if path is None:
+            raise ValueError(
+                f"No library {library_name} found for the current platform "
+                f"{_platform_name()}. This is a bug in the wheel, please report to the "
+                "maintainer."
+            )
+        return path
+
+    def _set_search_path(self) -> None:
+        """Append the library directories to the loader search path variable."""
+        platform_name = _platform_name()
+        env_var = (
+            "LD_LIBRARY_PATH"
+            if platform_name == "Linux"
+            else "DYLD_LIBRARY_PATH"
+            if platform_name == "Darwin"
+            else "PATH"
+        )
+        sep = os.pathsep
+        current = os.environ.get(env_var, "")
+        entries = current.split(sep) if current else []
+        for library_name in self._libraries:
+            directory = os.path.dirname(self._library_path(library_name))
+            if directory not in entries:
+                entries.append(directory)
+        os.environ[env_var] = sep.join(entries)
+
+    def load(  # noqa: PLR0913
+        self,
+        libraries: Iterable[str] | None = None,
+        *,
+        prefer_system: bool = False,
+        lazy: bool = False,
+        trigger: str | None = None,
+        parallel: bool | int = False,
+        warmup: bool = False,
+    ) -> None:
+        """Load the native libraries.
+
+        Loading is idempotent: libraries that this loader has already loaded are
+        skipped, and libraries that any loader in the process has already loaded from
+        the same path are reused from a process-wide cache. The resulting handles are
+        available from :meth:`handle`.
+
+        Libraries are loaded after all the libraries they depend on, which are loaded
+        even if they are not requested explicitly.
+
+        Parameters
+        ----------
+        libraries : typing.Iterable[str] | None
+            The names of the libraries to load. If None, all libraries are loaded.
+        prefer_system : bool
+            Whether or not to try loading a system library before the local version.
+            Default is False.
+        lazy : bool
+            If True, only record the libraries to load and defer loading them until
+            just before the first extension module matching ``trigger`` is created.
+            Default is False.
+        trigger : str | None
+            The name of the package whose extension modules trigger a lazy load, for
+            example the ``__name__`` of the consumer package. If None, any extension
+            module triggers the load. Ignored unless ``lazy`` is True.
+        parallel : bool | int
+            Whether to open the libraries concurrently from a thread pool. An integer
+            sets the maximum number of threads. Many dynamic loaders serialize the core
+            of each load behind a process-wide lock, so the benefit depends on how much
+            of the load time is spent waiting on I/O; the achieved speedup is recorded
+            in :attr:`parallel_speedup`. Libraries are opened concurrently with the
+            other libraries at the same level of the dependency graph, after all of
+            their dependencies have been loaded. Loads that cannot benefit, because no
+            level has several libraries or the library files add up to less than 16
+            MiB, are done serially instead. Default is False.
+        warmup : bool
+            Whether to prefetch the library files into the page cache first, see
+            :meth:`warmup`. For lazy loads the files are prefetched on a background
+            thread right away, so that they are read by the time the load happens.
+            Default is False.
+
+        """
+        if self._mode == LoadMode.ENV:
+            self._set_search_path()
+            return
+
+        pending = self._pending(libraries)
+        if not pending:
+            return
+
+        if warmup:
+            self.warmup(pending, background=lazy)
+
+        if lazy:
+            _LazyLoadFinder.defer(
+                self,
+                pending,
+                trigger,
+                {"prefer_system": prefer_system, "parallel": parallel},
+            )
+            return
+
+        _load_libraries(
+            [(self, library_name) for library_name in pending], prefer_system, parallel
+        )
+
+    async def load_async(
+        self,
+        libraries: Iterable[str] | None = None,
+        *,
+        prefer_system: bool = False,
+        parallel: bool | int = False,
+        warmup: bool = False,
+        executor: concurrent.futures.Executor | None = None,
+    ) -> None:
+        """Load the native libraries without blocking the running event loop.
+
+        The libraries are loaded as by :meth:`load`, sharing the same caches, on a
+        thread of ``executor``. The compiled companion module opens libraries with the
+        GIL released, so the event loop keeps running while they load. Libraries that
+        are already loaded return immediately, and concurrent awaits of the same
+        libraries wait for the load already in progress instead of starting another
+        one.
+
+        Parameters
+        ----------
+        libraries : typing.Iterable[str] | None
+            The names of the libraries to load. If None, all libraries are loaded.
+        prefer_system : bool
+            Whether or not to try loading a system library before the local version.
+            Default is False.
+        parallel : bool | int
+            Whether to open the libraries concurrently, see :meth:`load`. Default is
+            False.
+        warmup : bool
+            Whether to prefetch the library files into the page cache first. Default
+            is False.
+        executor : concurrent.futures.Executor | None
+            The executor to load the libraries on. If None, the default executor of
+            the event loop is used.
+
+        """
+        import asyncio
+
+        if self._mode == LoadMode.ENV:
+            self._set_search_path()
+            return
+
+        pending = self._pending(libraries)
+        in_progress = {
+            self._async_loads[name] for name in pending if name in self._async_loads
+        }
+        missing = [name for name in pending if name not in self._async_loads]
+        if missing:
+            import concurrent.futures
+
+            future: concurrent.futures.Future = concurrent.futures.Future()
+            # A running future cannot be cancelled, so cancelling one of the awaiting
+            # tasks does not affect the others.
+            future.set_running_or_notify_cancel()
+            for name in missing:
+                self._async_loads[name] = future
+
+            def load() -> None:
+                try:
+                    self.load(
+                        missing,
+                        prefer_system=prefer_system,
+                        parallel=parallel,
+                        warmup=warmup,
+                    )
+                except BaseException as e:  # noqa: BLE001
+                    self._finish_async_load(missing, future)
+                    future.set_exception(e)
+                else:
+                    self._finish_async_load(missing, future)
+                    future.set_result(None)
+
+            in_progress.add(future)
+            try:
+                asyncio.get_running_loop().run_in_executor(executor, load)
+            except BaseException as e:
+                self._finish_async_load(missing, future)
+                future.set_exception(e)
+                raise
+        for load_future in in_progress:
+            await asyncio.wrap_future(load_future)
+
+    def _finish_async_load(
+        self, libraries: Iterable[str], future: concurrent.futures.Future
+    ) -> None:
+        """Forget a load started by load_async before completing its future.
+
+        Awaits that start afterwards then find the libraries loaded, or retry the load
+        if it failed.
+        """
+        for name in libraries:
+            if self._async_loads.get(name) is future:
+                del self._async_loads[name]
+
+    def warmup(
+        self, libraries: Iterable[str] | None = None, *, background: bool = False
+    ) -> threading.Thread | None:
+        """Prefetch the files of the libraries into the page cache.
+
+        Loading a large library from cold storage stalls on many small random reads
+        as the dynamic loader touches its pages. Prefetching turns those into large
+        sequential reads, which is much faster on network-backed or otherwise slow
+        storage. Libraries that are already loaded are skipped.
+
+        Parameters
+        ----------
+        libraries : typing.Iterable[str] | None
+            The names of the libraries to prefetch, including their dependencies. If
+            None, all libraries are prefetched.
+        background : bool
+            Whether to prefetch on a background thread instead of waiting for the
+            prefetching to finish. Default is False.
+
+        Returns
+        -------
+        threading.Thread | None
+            The background thread, or None if ``background`` is False.
+
+        """
+        paths = [self._library_path(name) for name in self._pending(libraries)]
+        if not background:
+            _warmup_files(paths)
+            return None
+
+        import threading
+
+        thread = threading.Thread(
+            target=_warmup_files,
+            args=(paths,),
+            name="shared_lib_manager-warmup",
+            daemon=True,
+        )
+        thread.start()
+        return thread
+
+    def _pending(self, libraries: Iterable[str] | None) -> list[str]:
+        """Get the libraries that still need to be loaded, in load order.
+
+        Parameters
+        ----------
+        libraries : typing.Iterable[str] | None
+            The names of the requested libraries, or None for all libraries. The
+            dependencies of the requested libraries are included.
+
+        """
+        if libraries is None:
+            return [name for name in self._order if name not in self._handles]
+        needed: set[str] = set()
+        stack = []
+        for library_name in libraries:
+            if library_name not in self._libraries:
+                raise ValueError(f"Library {library_name} not found in the package.")
+            if library_name not in self._handles:
+                stack.append(library_name)
+        while stack:
+            library_name = stack.pop()
+            if library_name not in needed:
+                needed.add(library_name)
+                stack.extend(self._dependencies[library_name])
+        return [
+            name for name in self._order if name in needed and name not in self._handles
+        ]
+
+    def _record(
+        self,
+        library_name: str,
+        loaded: _LoadedLibrary,
+        cache_hit: bool,  # noqa: FBT001
+        system: bool,  # noqa: FBT001
+    ) -> None:
+        """Record a library loaded by this loader."""
+        with self._handles_lock:
+            previous = self._handles.get(library_name)
+            if previous is not loaded:
+                key = self._cache_key(loaded.path)
+                while True:
+                    with _load_lock(key):
+                        if _HANDLES.get(key) is loaded:
+                            loaded.refs += 1
+                            break
+                    # Another loader unloaded the library after it was loaded for
+                    # this one.
+                    loaded, _ = self._load(loaded.path, self._flags)
+                if previous is not None:
+                    _release(previous)
+            self._handles[library_name] = loaded
+            self._load_info[library_name] = (cache_hit, system)
+        if _TRACING:
+            _trace(
+                library_name,
+                loaded.path,
+                system=system,
+                cache_hit=cache_hit,
+                duration=0.0 if cache_hit else loaded.duration,
+            )
+
+    @staticmethod
+    def _prefers_system(library_name: str, prefer_system: bool) -> bool:  # noqa: FBT001
+        """Whether a system copy of the library should be tried first."""
+        return prefer_system or os.getenv(
+            f"PREFER_{library_name.upper()}_SYSTEM_LIBRARY", "false"
+        ).lower() not in ("false", 0)
+
+    def _load_library(
+        self,
+        library_name: str,
+        prefer_system: bool,  # noqa: FBT001
+    ) -> tuple[_LoadedLibrary, bool, bool]:
+        """Load a single library, trying the system copy first if preferred.
+
+        Returns
+        -------
+        tuple[_LoadedLibrary, bool, bool]
+            The loaded library, whether it was found in the process-wide cache, and
+            whether the system copy was loaded.
+
+        """
+        library_path = self._library_path(library_name)
+        if self._prefers_system(library_name, prefer_system):
+            system_name = os.path.basename(library_path)
+            known, resolved = _ResolutionCache.lookup(system_name)
+            if known and resolved is None:
+                # The system lookup failed last time and nothing has changed since.
+                return (*self._load(library_path, self._flags), False)
+            if known:
+                with contextlib.suppress(OSError):
+                    return (*self._load(resolved, self._flags), True)
+            try:
+                loaded, cache_hit = self._load(system_name, self._flags)
+            except OSError:
+                _ResolutionCache.store(system_name, None)
+            else:
+                # Successful lookups can only be remembered where the dynamic loader
+                # reports the path it found.
+                resolved = _loaded_path(loaded)
+                if resolved is not None:
+                    _ResolutionCache.store(system_name, resolved)
+                return loaded, cache_hit, True
+        return (*self._load(library_path, self._flags), False)
+
+    def handle(self, library_name: str, *, prefer_system: bool = False) -> ctypes.CDLL:
+        """Get the handle to a library, loading it first if necessary.
+
+        The returned object may be used to look up symbols in the library without
+        opening it again.
+
+        Parameters
+        ----------
+        library_name : str
+            The name of the library.
+        prefer_system : bool
+            Whether or not to try loading a system library before the local version if
+            the library has not been loaded yet. Default is False.
+
+        Returns
+        -------
+        ctypes.CDLL
+            The loaded library.
+
+        """
+        if self._mode == LoadMode.ENV:
+            raise ValueError("Libraries are not loaded in LoadMode.ENV.")
+        try:
+            return self._handles[library_name].cdll
+        except KeyError:
+            self.load((library_name,), prefer_system=prefer_system)
+            return self._handles[library_name].cdll
+
+    def symbol(
+        self,
+        library_name: str,
+        symbol_name: str,
+        restype: type | None = None,
+        argtypes: Iterable[type] = (),
+    ) -> Callable[..., object]:
+        """Get a function from a library with the given prototype.
+
+        The symbol is only looked up the first time a function with a given prototype
+        is requested. The function is cached for the whole process and shared between
+        loaders of the same library, so that repeated calls cost a dictionary lookup.
+        The library is loaded first if necessary.
+
+        Parameters
+        ----------
+        library_name : str
+            The name of the library.
+        symbol_name : str
+            The name of the function in the library.
+        restype : type | None
+            The ctypes type of the return value, or None if the function returns
+            nothing. Default is None.
+        argtypes : typing.Iterable[type]
+            The ctypes types of the arguments. Default is no arguments.
+
+        Returns
+        -------
+        typing.Callable
+            The prototyped ctypes function.
+
+        Raises
+        ------
+        AttributeError
+            If the library does not define the symbol.
+
+        """
+        key = (symbol_name, restype, tuple(argtypes))
+        try:
+            loaded = self._handles[library_name]
+        except KeyError:
+            self.handle(library_name)
+            loaded = self._handles[library_name]
+        try:
+            return loaded.symbols[key]
+        except KeyError:
+            pass
+
+        import ctypes
+
+        prototype = ctypes.CFUNCTYPE(restype, *key[2])
+        function = prototype((symbol_name, loaded.cdll))
+        return loaded.symbols.setdefault(key, function)
+
+    def stats(self) -> list[LibraryStats]:
+        """Get statistics about the libraries loaded by this loader.
+
+        Returns
+        -------
+        list[LibraryStats]
+            One entry per loaded library, in load order.
+
+        """
+        mapped_sizes = _mapped_sizes()
+        stats = []
+        for library_name, loaded in self._handles.items():
+            cache_hit, system = self._load_info[library_name]
+            path = _loaded_path(loaded)
+            file_size = None
+            if path is not None:
+                with contextlib.suppress(OSError):
+                    file_size = Path(path).stat().st_size
+            stats.append(
+                LibraryStats(
+                    name=library_name,
+                    path=path,
+                    load_time=loaded.duration,
+                    cache_hit=cache_hit,
+                    system=system,
+                    file_size=file_size,
+                    mapped_size=mapped_sizes.get(path) if path is not None else None,
+                )
+            )
+        return stats
+
+    def memory(self) -> list[LibraryMemory]:
+        """Get the memory used by the libraries loaded by this loader.
+
+        Returns
+        -------
+        list[LibraryMemory]
+            One entry per loaded library, in load order.
+
+        """
+        counters = _mapped_memory()
+        unknown = (None,) * (len(LibraryMemory._fields) - 2)
+        memory = []
+        for library_name, loaded in self._handles.items():
+            path = _loaded_path(loaded)
+            memory.append(
+                LibraryMemory(
+                    library_name,
+                    path,
+                    *(counters.get(path, unknown) if path is not None else unknown),
+                )
+            )
+        return memory
+
+    def unload(self, libraries: Iterable[str] | None = None) -> list[str]:
+        """Unload libraries that nothing else in the process uses.
+
+        The loader forgets the libraries, and each library is closed once no loader in
+        any interpreter of the process has it loaded, so that its memory is returned
+        to the system. Libraries are still never closed while they may be in use:
+        libraries loaded with ``RTLD_GLOBAL`` or ``RTLD_NODELETE``, and libraries
+        whose handle or functions from :meth:`handle` or :meth:`symbol` are still
+        referenced, stay loaded for later loads to reuse. Libraries that other
+        libraries link to are only unmapped by the dynamic loader once those are
+        unloaded as well. Libraries are unloaded in the reverse of their load order.
+
+        Parameters
+        ----------
+        libraries : typing.Iterable[str] | None
+            The names of the libraries to unload. If None, all libraries loaded by
+            this loader are unloaded.
+
+        Returns
+        -------
+        list[str]
+            The names of the libraries that were closed.
+
+        """
+        requested = None if libraries is None else set(libraries)
+        closed = []
+        for library_name in reversed(self._order):
+            if requested is not None and library_name not in requested:
+                continue
+            with self._handles_lock:
+                loaded = self._handles.pop(library_name, None)
+                self._load_info.pop(library_name, None)
+            if loaded is None:
+                continue
+            if _release(loaded):
+                closed.append(library_name)
+        return closed
+
+
+def _load_libraries(
+    pending: list[tuple[LibraryLoader, str]],
+    prefer_system: bool,  # noqa: FBT001
+    parallel: bool | int,  # noqa: FBT001
+) -> None:
+    """Load libraries of one or more loaders and record them in their loaders.
+
+    Parameters
+    ----------
+    pending : list[tuple[LibraryLoader, str]]
+        The loaders and names of the libraries to load. The libraries of each loader
+        must be in load order.
+    prefer_system : bool
+        Whether or not to try loading system libraries before the local versions.
+    parallel : bool | int
+        Whether to open the libraries concurrently, and optionally the maximum number
+        of threads to use.
+
+    """
+    _add_dll_directories(
+        loader._library_path(library_name)  # noqa: SLF001
+        for loader, library_name in pending
+    )
+
+    # Libraries that are the same library, by SONAME where it is known from
+    # precomputed headers and by resolved path otherwise, are only loaded once. The
+    # remaining copies reuse the loaded library afterwards.
+    unique = []
+    duplicates = []
+    first: dict[str, tuple[LibraryLoader, str]] = {}
+    for loader, library_name in pending:
+        info = loader._libraries[library_name].info  # noqa: SLF001
+        key = (
+            f"soname:{info.soname}"
+            if info is not None and info.soname is not None
+            else LibraryLoader._cache_key(loader._library_path(library_name))  # noqa: SLF001
+        )
+        if key in first:
+            duplicates.append((loader, library_name, first[key]))
+        else:
+            first[key] = (loader, library_name)
+            unique.append((loader, library_name))
+
+    try:
+        if parallel and _worth_parallel(unique):
+            _load_parallel(unique, prefer_system, parallel)
+        else:
+            if parallel:
+                for loader in {loader for loader, _ in unique}:
+                    loader.parallel_speedup = None
+            _load_serial(unique, prefer_system)
+    except OSError as e:
+        if _TRACING:
+            # Libraries are loaded in order and loading stops at the first failure,
+            # so the failed library is the first one that was not loaded.
+            failed = next(
+                (
+                    (library_name, loader._library_path(library_name))  # noqa: SLF001
+                    for loader, library_name in unique
+                    if library_name not in loader._handles  # noqa: SLF001
+                    and LibraryLoader._cache_key(loader._library_path(library_name))  # noqa: SLF001
+                    not in _HANDLES
+                ),
+                (None, None),
+            )
+            _trace(
+                *failed,
+                system=False,
+                cache_hit=False,
+                duration=0.0,
+                error=str(e),
+            )
+        raise
+
+    for loader, library_name, (first_loader, first_name) in duplicates:
+        original = first_loader._handles[first_name]  # noqa: SLF001
+        # Loading the original again promotes it if this loader needs stronger flags.
+        loaded, _ = LibraryLoader._load(original.path, loader._flags)  # noqa: SLF001
+        system = first_loader._load_info[first_name][1]  # noqa: SLF001
+        loader._record(library_name, loaded, cache_hit=True, system=system)  # noqa: SLF001
+
+    if _CHECK_CONFLICTS:
+        _report_conflicts()
+
+
+def _load_serial(
+    pending: list[tuple[LibraryLoader, str]],
+    prefer_system: bool,  # noqa: FBT001
+) -> None:
+    """Load libraries one after the other, batching them where possible."""
+
+    # Consecutive libraries without system lookups that share their flags are opened
+    # in one batch. A batch is completed before anything after it is loaded, so that
+    # dependencies are always loaded first.
+    batch: list[tuple[LibraryLoader, str]] = []
+
+    def load_batch() -> None:
+        if not batch:
+            return
+        results = LibraryLoader._load_many(  # noqa: SLF001
+            [loader._library_path(name) for loader, name in batch],  # noqa: SLF001
+            batch[0][0]._flags,  # noqa: SLF001
+        )
+        for (loader, library_name), (loaded, cache_hit) in zip(batch, results):
+            loader._record(library_name, loaded, cache_hit, system=False)  # noqa: SLF001
+        batch.clear()
+
+    for loader, library_name in pending:
+        if loader._prefers_system(library_name, prefer_system):  # noqa: SLF001
+            load_batch()
+            loader._record(  # noqa: SLF001
+                library_name,
+                *loader._load_library(library_name, prefer_system),  # noqa: SLF001
+            )
+        else:
+            if batch and batch[0][0]._flags != loader._flags:  # noqa: SLF001
+                load_batch()
+            batch.append((loader, library_name))
+    load_batch()
+
+
+def _worth_parallel(pending: list[tuple[LibraryLoader, str]]) -> bool:
+    """Check whether loading libraries concurrently can be faster than serially.
+
+    That needs a level of the dependency graph with several libraries to open at once,
+    and enough data to read that waiting on I/O can overlap.
+    """
+    levels = [loader._levels[library_name] for loader, library_name in pending]  # noqa: SLF001
+    if len(set(levels)) == len(levels):
+        return False
+    size = 0
+    for loader, library_name in pending:
+        with contextlib.suppress(OSError):
+            size += os.stat(loader._library_path(library_name)).st_size  # noqa: SLF001
+        if size >= _PARALLEL_MIN_SIZE:
+            return True
+    return False
+
+
+def _load_parallel(
+    pending: list[tuple[LibraryLoader, str]],
+    prefer_system: bool,  # noqa: FBT001
+    parallel: bool | int,  # noqa: FBT001
+) -> None:
+    """Load libraries concurrently and record the achieved speedup in their loaders.
+
+    The libraries are loaded one level of their loader's dependency graph at a time.
+    Levels with a single library are loaded on the calling thread.
+    """
+    levels: dict[int, list[tuple[LibraryLoader, str]]] = {}
+    for loader, library_name in pending:
+        level = loader._levels[library_name]  # noqa: SLF001
+        levels.setdefault(level, []).append((loader, library_name))
+    max_workers = min(
+        max(len(level) for level in levels.values()),
+        _DEFAULT_MAX_WORKERS if parallel is True else int(parallel),
+    )
+    durations = []
+
+    def load_one(
+        entry: tuple[LibraryLoader, str],
+    ) -> tuple[_LoadedLibrary, bool, bool]:
+        loader, library_name = entry
+        start = time.perf_counter()
+        result = loader._load_library(library_name, prefer_system)  # noqa: SLF001
+        durations.append(time.perf_counter() - start)
+        return result
+
+    from concurrent.futures import ThreadPoolExecutor
+
+    start = time.perf_counter()
+    with ThreadPoolExecutor(
+        max_workers=max_workers, thread_name_prefix="shared_lib_manager"
+    ) as executor:
+        for level in sorted(levels):
+            entries = levels[level]
+            results = (
+                executor.map(load_one, entries)
+                if len(entries) > 1
+                else [load_one(entries[0])]
+            )
+            for (loader, library_name), result in zip(entries, results):
+                loader._record(library_name, *result)  # noqa: SLF001
+    elapsed = time.perf_counter() - start
+
+    speedup = sum(durations) / elapsed if elapsed > 0 else None
+    for loader, _ in pending:
+        loader.parallel_speedup = speedup
+
+
+def load_all(
+    loaders: Iterable[LibraryLoader],
+    *,
+    prefer_system: bool = False,
+    parallel: bool | int = False,
+    warmup: bool = False,
+) -> None:
+    """Load all the libraries of several loaders as a single batch.
+
+    This is equivalent to calling :meth:`LibraryLoader.load` on each loader, but the
+    libraries of all loaders are loaded in one pass: libraries that are the same, by
+    SONAME where it is known from precomputed headers and by resolved path otherwise,
+    are opened once, consecutive libraries that need no system lookup and share
+    their flags are opened in a single batch, and parallel loads share one thread
+    pool across all loaders. Libraries are loaded in the order of the loaders, each
+    after its current loader's dependencies.
+
+    Parameters
+    ----------
+    loaders : typing.Iterable[LibraryLoader]
+        The loaders whose libraries to load.
+    prefer_system : bool
+        Whether or not to try loading system libraries before the local versions.
+        Default is False.
+    parallel : bool | int
+        Whether to open the libraries concurrently from a thread pool, as in
+        :meth:`LibraryLoader.load`. Default is False.
+    warmup : bool
+        Whether to prefetch the library files of all loaders into the page cache
+        before loading any of them, see :meth:`LibraryLoader.warmup`. Default is False.
 
     """
+    pending = []
+    for loader in dict.fromkeys(loaders):
+        if loader._mode == LoadMode.ENV:  # noqa: SLF001
+            loader._set_search_path()  # noqa: SLF001
+        else:
+            pending.extend(
+                (loader, library_name)
+                for library_name in loader._pending(None)  # noqa: SLF001
+            )
+    if not pending:
+        return
+    if warmup:
+        _warmup_files(
+            loader._library_path(library_name)  # noqa: SLF001
+            for loader, library_name in pending
+        )
+    _load_libraries(pending, prefer_system, parallel)
 
-    Linux: Path | None
-    Darwin: Path | None
-    Windows: Path | None
 
-    def __init__(
-        self,
-        *,
-        Darwin: os.PathLike | str | None = None,  # noqa: N803
-        Linux: os.PathLike | str | None = None,  # noqa: N803
-        Windows: os.PathLike | str | None = None,  # noqa: N803
-        default: Callable[[], os.PathLike | str] | None = None,
-    ):
-        # public attributes should correspond to platform.system() return values:
-        # https://docs.python.org/3/library/platform.html#platform.system
-        # TODO: Determine if sys.platform is more appropriate
-        # https://discuss.python.org/t/clarify-usage-of-platform-system/70900/4
-        if not all(
-            isinstance(path, (os.PathLike, str)) or path is None
-            for path in (Darwin, Linux, Windows)
-        ):
-            raise TypeError("Paths must be instances of pathlib.Path, str, or None.")
-        self.Darwin = Path(Darwin) if Darwin else None
-        self.Linux = Path(Linux) if Linux else None
-        self.Windows = Path(Windows) if Windows else None
-        if not all(
-            p.is_absolute()
-            for p in (self.Darwin, self.Linux, self.Windows)
-            if p is not None
+# All loaders in the process, used to report statistics.
+_LOADERS: weakref.WeakSet[LibraryLoader] = weakref.WeakSet()
+
+
+def preload_all(
+    *, prefer_system: bool = False, parallel: bool | int = False, warmup: bool = False
+) -> None:
+    """Load the libraries of every loader created in this process.
+
+    This is meant to be called by servers before they fork their workers. The workers
+    inherit the loaded libraries, sharing the parent's memory mappings copy-on-write,
+    and the cached handles, so that loads in the workers cost nothing. Loads that
+    were deferred with ``lazy=True`` are performed as well.
+
+    Parameters
+    ----------
+    prefer_system : bool
+        Whether or not to try loading system libraries before the local versions.
+        Default is False.
+    parallel : bool | int
+        Whether to open the libraries concurrently from a thread pool, as in
+        :meth:`LibraryLoader.load`. Default is False.
+    warmup : bool
+        Whether to prefetch the library files into the page cache first, see
+        :meth:`LibraryLoader.warmup`. Default is False.
+
+    """
+    load_all(
+        list(_LOADERS), prefer_system=prefer_system, parallel=parallel, warmup=warmup
+    )
+
+
+#: The entry point group in which packages register the modules that ship libraries.
+ENTRY_POINT_GROUP = "shared_lib_manager.libraries"
+
+# The background thread started by start_preload, if any.
+_preload_thread: threading.Thread | None = None
+
+
+def _preload_module_names(setting: str) -> list[str]:
+    """Get the modules to preload from the value of SHARED_LIB_MANAGER_PRELOAD."""
+    names = [name.strip() for name in setting.split(",") if name.strip()]
+    if names and names != ["1"] and names != ["all"]:
+        return names
+    from importlib.metadata import entry_points
+
+    eps = entry_points()
+    if hasattr(eps, "select"):
+        group = eps.select(group=ENTRY_POINT_GROUP)
+    else:
+        # Python 3.9 returns a dict of groups.
+        group = eps.get(ENTRY_POINT_GROUP, ())
+    return sorted({ep.value for ep in group})
+
+
+def _manifest_loaders(module_names: Iterable[str]) -> list[LibraryLoader]:
+    """Get the loaders of the modules that ship manifests, without importing them."""
+    import importlib.util
+
+    loaders = []
+    for module_name in module_names:
+        try:
+            spec = importlib.util.find_spec(module_name)
+        except (ImportError, ValueError):
+            continue
+        for location in (spec and spec.submodule_search_locations) or ():
+            manifest = os.path.join(location, MANIFEST_NAME)
+            if os.path.isfile(manifest):
+                with contextlib.suppress(OSError, ValueError):
+                    loaders.append(LibraryLoader.from_manifest(manifest))
+                break
+    return loaders
+
+
+def _preload_manifests(module_names: Iterable[str] | None) -> None:
+    """Load the libraries of the modules that ship manifests."""
+    if module_names is None:
+        module_names = _preload_module_names(
+            os.getenv("SHARED_LIB_MANAGER_PRELOAD", "")
+        )
+    loaders = _manifest_loaders(module_names)
+    try:
+        load_all(loaders)
+    except OSError:
+        # Preload whatever can be loaded, and leave reporting failures to the loads
+        # that the packages themselves perform.
+        for loader in loaders:
+            with contextlib.suppress(OSError):
+                loader.load()
+
+
+def start_preload(module_names: Iterable[str] | None = None) -> threading.Thread:
+    """Start loading the libraries of installed modules on a background thread.
+
+    This is meant to be called at interpreter startup, so that the libraries are
+    opened while the main thread is still importing Python modules. It is called by
+    the ``shared_lib_manager_preload.pth`` file installed with this package when the
+    ``SHARED_LIB_MANAGER_PRELOAD`` environment variable is set, either to a
+    comma-separated list of modules or to ``1`` for all modules registered in the
+    ``shared_lib_manager.libraries`` entry point group. Only modules that ship a
+    manifest are preloaded, since importing packages from a background thread during
+    startup could deadlock on the import lock.
+
+    Loads performed while the preload is in progress wait for the libraries the
+    preload is opening instead of opening them again, and are free once the preload
+    has finished. Failed loads are left to be retried, and reported, by the loads of
+    the packages themselves.
+
+    Parameters
+    ----------
+    module_names : typing.Iterable[str] | None
+        The names of the modules whose libraries to load. If None, they are read from
+        ``SHARED_LIB_MANAGER_PRELOAD``.
+
+    Returns
+    -------
+    threading.Thread
+        The background thread. Repeated calls return the thread of the first call.
+
+    """
+    global _preload_thread  # noqa: PLW0603
+    if _preload_thread is not None:
+        return _preload_thread
+
+    import threading
+
+    # The registered modules are discovered on the background thread as well.
+    thread = threading.Thread(
+        target=_preload_manifests,
+        args=(None if module_names is None else list(module_names),),
+        name="shared_lib_manager-preload",
+        daemon=True,
+    )
+    thread.start()
+    _preload_thread = thread
+    return thread
+
+
+def wait_for_preload(timeout: float | None = None) -> bool:
+    """Wait for the preload started by :func:`start_preload` to finish.
+
+    Parameters
+    ----------
+    timeout : float | None
+        The maximum number of seconds to wait. If None, wait until it finishes.
+
+    Returns
+    -------
+    bool
+        Whether the preload has finished, which is also the case if none was started.
+
+    """
+    thread = _preload_thread
+    if thread is None:
+        return True
+    thread.join(timeout)
+    return not thread.is_alive()
+
+
+# The version of the load plan format written by compile_load_plan.
+_LOAD_PLAN_VERSION = 1
+
+
+def compile_load_plan(
+    plan: os.PathLike | str,
+    module_names: Iterable[str] | None = None,
+    *,
+    prefer_system: bool = False,
+) -> list[str]:
+    """Resolve and load the libraries of installed modules and write down the result.
+
+    This is meant to be run when building an immutable environment, such as a
+    container image. The libraries of the modules are loaded as by :func:`load_all`,
+    and the plan records, in load order, the absolute path of every library that was
+    opened, including system copies if they are preferred, with the flags it was
+    opened with, the SONAME it is expected to have, and the inode, size and
+    modification time of its file. System copies also record the name they were
+    looked up by. :func:`replay_load_plan` then opens exactly those files at startup
+    without resolving anything.
+
+    Parameters
+    ----------
+    plan : os.PathLike | str
+        The path to write the plan to.
+    module_names : typing.Iterable[str] | None
+        The names of the modules whose libraries to load, which must ship manifests.
+        If None, all modules registered in the ``shared_lib_manager.libraries`` entry
+        point group are used.
+    prefer_system : bool
+        Whether or not to try loading system libraries before the local versions.
+        Default is False.
+
+    Returns
+    -------
+    list[str]
+        The paths of the libraries in the plan, in load order.
+
+    """
+    import json
+    import tempfile
+
+    loaders = _manifest_loaders(
+        _preload_module_names("") if module_names is None else module_names
+    )
+    load_all(loaders, prefer_system=prefer_system)
+    entries: dict[str, dict] = {}
+    for loader in loaders:
+        for library_name in loader._order:  # noqa: SLF001
+            loaded = loader._handles.get(library_name)  # noqa: SLF001
+            path = None if loaded is None else _loaded_path(loaded)
+            if path is None or path in entries:
+                continue
+            library = loader._libraries[library_name]  # noqa: SLF001
+            requires = next(
+                (
+                    sorted(variant.requires)
+                    for variant in library.variants
+                    if variant._paths.get(_platform_name())  # noqa: SLF001
+                    and os.path.realpath(variant._paths[_platform_name()]) == path  # noqa: SLF001
+                ),
+                [],
+            )
+            try:
+                soname = read_library_info(path).soname
+            except (OSError, ValueError):
+                soname = None
+            stat = os.stat(path)
+            entries[path] = {
+                "name": library_name,
+                "path": path,
+                # The name that a system lookup of the library was made with, which
+                # is what prefer_system loads find the library in the cache by.
+                "system_name": None if os.path.isabs(loaded.path) else loaded.path,
+                "flags": loaded.flags,
+                "soname": soname,
+                "requires": requires,
+                "sha256": _CONTENT_DIGESTS.get(path),
+                "inode": stat.st_ino,
+                "size": stat.st_size,
+                "mtime_ns": stat.st_mtime_ns,
+            }
+
+    plan = os.fspath(plan)
+    directory = os.path.dirname(os.path.abspath(plan))
+    fd, temporary = tempfile.mkstemp(
+        prefix=f"{os.path.basename(plan)}.", suffix=".tmp", dir=directory
+    )
+    try:
+        with os.fdopen(fd, "w") as f:
+            json.dump(
+                {
+                    "version": _LOAD_PLAN_VERSION,
+                    "prefix": sys.prefix,
+                    "platform": _platform_name(),
+                    "libraries": list(entries.values()),
+                },
+                f,
+                indent=4,
+            )
+            f.write("\n")
+        os.replace(temporary, plan)
+    except OSError:
+        os.unlink(temporary)
+        raise
+    return list(entries)
+
+
+def replay_load_plan(plan: os.PathLike | str) -> bool:
+    """Open the libraries recorded by :func:`compile_load_plan`.
+
+    The libraries are opened directly from their recorded paths and with their
+    recorded flags, in batches, and added to the process-wide cache, so that the
+    loads of the packages themselves cost a dictionary lookup afterwards. System
+    copies are cached under the name they were looked up by, as if that lookup had
+    been made, so that loads preferring system libraries find them too. Nothing is
+    resolved: the only checks are one ``stat`` per library, whose inode, size and
+    modification time must match the plan, and that the CPU supports the variants
+    that were chosen. If anything differs, nothing is loaded and the packages load
+    their libraries as usual.
+
+    The ``shared_lib_manager_preload.pth`` startup hook calls this with the path in
+    the ``SHARED_LIB_MANAGER_LOAD_PLAN`` environment variable, if it is set.
+
+    Parameters
+    ----------
+    plan : os.PathLike | str
+        The path to the plan.
+
+    Returns
+    -------
+    bool
+        Whether the plan was up to date and its libraries were loaded.
+
+    """
+    import itertools
+    import json
+
+    try:
+        with open(plan) as f:  # noqa: PTH123
+            data = json.load(f)
+        if (
+            data["version"] != _LOAD_PLAN_VERSION
+            or data["prefix"] != sys.prefix
+            or data["platform"] != _platform_name()
         ):
-            raise ValueError("All paths must be absolute.")
-        self.default = default
+            return False
+        entries = data["libraries"]
+        for entry in entries:
+            stat = os.stat(entry["path"])
+            if (
+                stat.st_ino != entry["inode"]
+                or stat.st_size != entry["size"]
+                or stat.st_mtime_ns != entry["mtime_ns"]
+                or not set(entry["requires"]) <= cpu_features()
+                or not isinstance(entry["system_name"], (str, type(None)))
+            ):
+                return False
+    except (OSError, ValueError, KeyError, TypeError):
+        return False
 
+    for entry in entries:
+        if entry["sha256"] is not None:
+            _CONTENT_DIGESTS[entry["path"]] = entry["sha256"]
+    # Consecutive libraries with the same flags are opened in one batch, which keeps
+    # every library after the libraries it was loaded after when the plan was made.
+    batches = itertools.groupby(
+        entries, key=lambda entry: (entry["flags"], entry["system_name"] is not None)
+    )
+    _add_dll_directories(entry["path"] for entry in entries)
+    try:
+        for (flags, system), batch in batches:
+            if not system:
+                LibraryLoader._load_many([entry["path"] for entry in batch], flags)  # noqa: SLF001
+                continue
+            for entry in batch:
+                _load_as(entry["system_name"], entry["path"], flags)
+    except OSError:
+        return False
+    return True
 
-class LibraryLoader:
-    """Loader for a set of native libraries associated with a module.
+
+def _load_as(key: str, library_path: str, flags: int) -> None:
+    """Open a library by path and cache it as if it had been loaded as ``key``.
+
+    This is how a replayed system library is cached under the bare name that a system
+    lookup would have loaded it by, without repeating the search for it.
+    """
+    with _load_lock(key):
+        if key in _HANDLES or _registered(key, key) is not None:
+            return
+        ((result, duration),) = _dlopen_many([library_path], flags)
+        if isinstance(result, OSError):
+            raise result
+        loaded = _HANDLES[key] = _LoadedLibrary(key, result, flags, duration)
+        _register(key, loaded)
+
+
+def _symbol_list(names: Iterable[str], limit: int = 5) -> str:
+    """Format some of the given symbol names for a report."""
+    names = sorted(names)
+    shown = ", ".join(names[:limit])
+    return f"{shown}, ..." if len(names) > limit else shown
+
+
+# The headers and symbols of the library files read by find_conflicts, by resolved
+# path, together with the inode, size and modification time they were read at. Each
+# file is only parsed again if it changes, so checking for conflicts after every load
+# does not read all earlier libraries again.
+_PARSED_FILES: dict[
+    str, tuple[tuple[int, int, int], tuple[LibraryInfo, LibrarySymbols]]
+] = {}
+
+
+def _parse_for_conflicts(path: str) -> tuple[LibraryInfo, LibrarySymbols]:
+    """Read the headers and symbols of a library file, reusing an earlier read."""
+    stat = os.stat(path)
+    identity = (stat.st_ino, stat.st_size, stat.st_mtime_ns)
+    cached = _PARSED_FILES.get(path)
+    if cached is not None and cached[0] == identity:
+        return cached[1]
+    parsed = (read_library_info(path), read_library_symbols(path))
+    _PARSED_FILES[path] = (identity, parsed)
+    return parsed
+
+
+def find_conflicts(loaders: Iterable[LibraryLoader] | None = None) -> list[str]:
+    """Find libraries that may bind to the wrong symbols once they are loaded.
+
+    The dynamic symbols of every library of the loaders are read from the library
+    files, without loading them, and indexed in a single map from symbol names to
+    the libraries defining them. Each file is only read once per process unless it
+    changes. The index is then used to report, in one pass:
+
+    - different files with the same SONAME (or install name or export name), of which
+      only the first one loaded is used,
+    - symbols defined by more than one library, where those of libraries loaded with
+      RTLD_GLOBAL take precedence over the definitions of all libraries loaded later,
+    - libraries using symbols of another library that they do not depend on, which
+      only resolve if that library happened to be loaded with RTLD_GLOBAL first.
 
     Parameters
     ----------
-    libraries : dict[str, PlatformLibrary | tuple[os.PathLike | str, os.PathLike | str, os.PathLike | str]]
-        A mapping from library names to the paths of the libraries on each platform. If
-        a tuple is passed, it must be ordered as (Linux, Darwin, Windows).
+    loaders : typing.Iterable[LibraryLoader] | None
+        The loaders whose libraries to check. If None, all loaders in the process are
+        checked.
 
-    """  # noqa: E501
+    Returns
+    -------
+    list[str]
+        A description of each problem found, including libraries that could not be
+        read.
 
-    def __init__(
-        self,
-        libraries: dict[str, PlatformLibrary],
-    ):
-        platform_name = platform.system()
+    """
+    if loaders is None:
+        loaders = list(_LOADERS)
+    rtld_global = getattr(os, "RTLD_GLOBAL", 0)
+    issues = []
+    # The distinct library files, by resolved path, with their headers, symbols and
+    # whether any loader loads them with RTLD_GLOBAL.
+    files: dict[str, tuple[LibraryInfo, LibrarySymbols]] = {}
+    global_files: set[str] = set()
+    for loader in dict.fromkeys(loaders):
+        for library_name, library in loader._libraries.items():  # noqa: SLF001
+            loaded = loader._handles.get(library_name)  # noqa: SLF001
+            path = _loaded_path(loaded) if loaded is not None else library._resolve()  # noqa: SLF001
+            if path is None:
+                continue
+            path = os.path.realpath(path)
+            flags = loaded.flags if loaded is not None else loader._flags  # noqa: SLF001
+            if flags & rtld_global:
+                global_files.add(path)
+            if path in files:
+                continue
+            try:
+                files[path] = _parse_for_conflicts(path)
+            except (OSError, ValueError) as e:
+                issues.append(str(e))
 
-        self._libraries = {}
-        for lib, path in libraries.items():
-            if not isinstance(path, PlatformLibrary):
-                raise TypeError(
-                    f"Invalid path {path} for library {lib}. Expected a tuple or "
-                    "PlatformLibrary."
+    def soname(path: str) -> str:
+        info = files[path][0]
+        name = os.path.basename(info.soname or path)
+        return name.lower() if info.file_format == "PE" else name
+
+    providers: dict[str, list[str]] = {}
+    for path in files:
+        providers.setdefault(soname(path), []).append(path)
+    for name, paths in providers.items():
+        if len(paths) > 1:
+            issues.append(
+                f"{name} is provided by several files, of which only the first one "
+                f"loaded is used: {', '.join(paths)}"
+            )
+
+    # Only symbols defined more than once or used by another library need to be
+    # indexed, and finding those with set operations at C speed keeps the Python
+    # loops over symbols short even for environments with many thousands of them.
+    seen: set[str] = set()
+    repeated: set[str] = set()
+    used: set[str] = set()
+    for _, symbols in files.values():
+        repeated |= seen & symbols.defined
+        seen |= symbols.defined
+        used |= symbols.undefined
+    definitions: dict[str, list[str]] = {}
+    for path, (_, symbols) in files.items():
+        for name in symbols.defined & repeated:
+            definitions.setdefault(name, []).append(path)
+    clashes: dict[tuple[str, ...], list[str]] = {}
+    for name, paths in definitions.items():
+        clashes.setdefault(tuple(paths), []).append(name)
+    # Weak definitions do not clash, but do satisfy undefined symbols.
+    for path, (_, symbols) in files.items():
+        for name in (symbols.defined - repeated | symbols.weak) & used:
+            definitions.setdefault(name, []).append(path)
+    for paths, names in clashes.items():
+        if len({soname(path) for path in paths}) == 1:
+            # Copies of the same library, which are reported above.
+            continue
+        winners = [path for path in paths if path in global_files]
+        if winners:
+            issues.append(
+                f"{len(names)} symbols are defined by each of {', '.join(paths)}, and "
+                f"those of {', '.join(winners)}, loaded with RTLD_GLOBAL, take "
+                f"precedence: {_symbol_list(names)}"
+            )
+        else:
+            issues.append(
+                f"{len(names)} symbols are defined by each of {', '.join(paths)}: "
+                f"{_symbol_list(names)}"
+            )
+
+    # Symbols used by each library but defined only by checked libraries that are not
+    # among its direct or indirect dependencies.
+    provided = set(definitions)
+    for path, (info, symbols) in files.items():
+        resolved = symbols.undefined & provided
+        if not resolved:
+            continue
+        dependencies = {path}
+        stack = list(info.needed)
+        while stack:
+            for dependency in providers.get(os.path.basename(stack.pop()), ()):
+                if dependency not in dependencies:
+                    dependencies.add(dependency)
+                    stack.extend(files[dependency][0].needed)
+        undeclared: dict[tuple[str, ...], list[str]] = {}
+        for name in resolved:
+            paths = definitions[name]
+            if dependencies.isdisjoint(paths):
+                undeclared.setdefault(tuple(paths), []).append(name)
+        for paths, names in undeclared.items():
+            resolving = [path for path in paths if path in global_files]
+            if resolving:
+                issues.append(
+                    f"{path} uses {len(names)} symbols of {', '.join(resolving)} "
+                    "without depending on it, which only resolve because it is "
+                    f"loaded with RTLD_GLOBAL: {_symbol_list(names)}"
                 )
+            else:
+                issues.append(
+                    f"{path} uses {len(names)} symbols of {', '.join(paths)} without "
+                    "depending on it, which do not resolve unless it is loaded with "
+                    f"RTLD_GLOBAL first: {_symbol_list(names)}"
+                )
+    return issues
 
-            try:
-                self._libraries[lib] = getattr(path, platform_name)
-            except AttributeError:
-                if path.default is not None:
-                    self._libraries[lib] = Path(path.default())
-                else:
-                    raise ValueError(
-                        f"No library {lib} found for the current platform "
-                        f"{platform_name}. This is a bug in the wheel, please report "
-                        "to the maintainer."
-                    ) from None
+
+# With SHARED_LIB_MANAGER_CHECK_CONFLICTS set, every load reports the conflicts among
+# the libraries of all loaders in the process as a LibraryConflictWarning, each one only
+# once.
+_CHECK_CONFLICTS = os.getenv("SHARED_LIB_MANAGER_CHECK_CONFLICTS", "").lower() not in (
+    "",
+    "0",
+    "false",
+)
+_REPORTED_CONFLICTS: set[str] = set()
+
+
+class LibraryConflictWarning(RuntimeWarning):
+    """A conflict between libraries, reported with SHARED_LIB_MANAGER_CHECK_CONFLICTS.
+
+    The message is one of the descriptions returned by :func:`find_conflicts`.
+    """
+
+
+class LoadEvent(NamedTuple):
+    """A library load reported to the hooks added with :func:`add_trace_hook`.
+
+    Attributes
+    ----------
+    name : str | None
+        The name of the library in its loader, or None if a failed load could not be
+        attributed to a library.
+    path : str | None
+        The path of the library that was opened, or the name it was looked up by for
+        system libraries.
+    system : bool
+        Whether the system copy of the library was loaded instead of the bundled one.
+    cache_hit : bool
+        Whether the library had already been loaded by another loader in the process.
+    start_time : int
+        When the library started loading, in nanoseconds since the epoch as returned
+        by :func:`time.time_ns`. Libraries opened in a batch are reported when the
+        batch completes, so their start time is derived from their duration.
+    duration : float
+        The time in seconds spent opening the library, 0 for cache hits and failures.
+    error : str | None
+        The error message if the library could not be loaded.
+
+    """
+
+    name: str | None
+    path: str | None
+    system: bool
+    cache_hit: bool
+    start_time: int
+    duration: float
+    error: str | None = None
+
+
+# Whether library loads are reported as "shared_lib_manager.load" audit events.
+# Interpreters built with DTrace or SystemTap support fire their "audit" probe for
+# every audit event, so bpftrace and perf can attach to these without any hooks.
+_AUDIT_LOADS = os.getenv("SHARED_LIB_MANAGER_TRACE", "").lower() not in (
+    "",
+    "0",
+    "false",
+)
+_TRACE_HOOKS: list[Callable[[LoadEvent], object]] = []
+# The only check made when loading libraries without tracing.
+_TRACING = _AUDIT_LOADS
+
+
+def _trace(  # noqa: PLR0913
+    name: str | None,
+    path: str | None,
+    *,
+    system: bool,
+    cache_hit: bool,
+    duration: float,
+    error: str | None = None,
+) -> None:
+    """Report a library load to the audit event and the trace hooks."""
+    event = LoadEvent(
+        name,
+        path,
+        system,
+        cache_hit,
+        time.time_ns() - int(duration * 1e9),
+        duration,
+        error,
+    )
+    if _AUDIT_LOADS:
+        sys.audit("shared_lib_manager.load", *event)
+    for hook in tuple(_TRACE_HOOKS):
+        try:
+            hook(event)
+        except Exception:  # noqa: BLE001
+            # A broken hook must not break loading the libraries.
+            import traceback
+
+            traceback.print_exc()
+
+
+def add_trace_hook(hook: Callable[[LoadEvent], object]) -> None:
+    """Call a function for every library that a loader records or fails to load.
+
+    This is meant for emitting a span per library into a tracing system such as
+    OpenTelemetry. The hook is called with a :class:`LoadEvent` on the thread that
+    loaded the library, right after it is loaded, including for libraries loaded
+    through ``shared_lib_consumer``. Setting ``SHARED_LIB_MANAGER_TRACE=1`` reports
+    the same events with :func:`sys.audit` as "shared_lib_manager.load", with the
+    fields of the event as arguments. Without hooks or the environment variable,
+    loading only checks a single flag.
+
+    Parameters
+    ----------
+    hook : typing.Callable[[LoadEvent], object]
+        The function to call. Exceptions it raises are printed and otherwise ignored.
+
+    """
+    global _TRACING  # noqa: PLW0603
+    _TRACE_HOOKS.append(hook)
+    _TRACING = True
+
+
+def remove_trace_hook(hook: Callable[[LoadEvent], object]) -> None:
+    """Stop calling a function added with :func:`add_trace_hook`.
+
+    Raises
+    ------
+    ValueError
+        If the function is not a trace hook.
+
+    """
+    global _TRACING  # noqa: PLW0603
+    _TRACE_HOOKS.remove(hook)
+    _TRACING = _AUDIT_LOADS or bool(_TRACE_HOOKS)
+
+
+def _report_conflicts() -> None:
+    """Warn about the conflicts that have not been reported yet, see find_conflicts."""
+    import warnings
+
+    for issue in find_conflicts():
+        if issue not in _REPORTED_CONFLICTS:
+            _REPORTED_CONFLICTS.add(issue)
+            warnings.warn(issue, LibraryConflictWarning, stacklevel=2)
+
+
+def _dump_stats(destination: str) -> None:
+    """Report the statistics of all loaders in the process.
+
+    Parameters
+    ----------
+    destination : str
+        Either "1" or "stderr" to print a summary table to stderr, or the path of a file
+        to write the statistics to as JSON.
+
+    """
+    stats = [entry for loader in list(_LOADERS) for entry in loader.stats()]
+    stats.sort(key=lambda entry: entry.load_time, reverse=True)
+    if destination.lower() not in ("1", "true", "stderr"):
+        import json
+
+        with Path(destination).open("w") as f:
+            json.dump([entry._asdict() for entry in stats], f, indent=2)
+        return
+
+    total = sum(entry.load_time for entry in stats if not entry.cache_hit)
+    lines = [
+        f"shared_lib_manager: loaded {len(stats)} libraries in {total * 1e3:.2f} ms",
+        f"{'load (ms)':>10} {'size (KiB)':>11} {'source':>8}  library",
+    ]
+    for entry in stats:
+        source = (
+            "cached" if entry.cache_hit else "system" if entry.system else "bundled"
+        )
+        size = f"{entry.file_size / 1024:.0f}" if entry.file_size is not None else "?"
+        lines.append(
+            f"{entry.load_time * 1e3:>10.2f} {size:>11} {source:>8}  "
+            f"{entry.name} ({entry.path})"
+        )
+    print("\n".join(lines), file=sys.stderr)
+
+
+if _stats_destination := os.getenv("SHARED_LIB_MANAGER_STATS"):
+    import atexit
+
+    atexit.register(_dump_stats, _stats_destination)
+
+
+class _PreloadingExtensionFileLoader(importlib.machinery.ExtensionFileLoader):
+    """Extension module loader that runs deferred library loads first.
+
+    The extension module's shared library is opened in create_module, so that is the
+    last point at which its dependencies can be loaded.
+    """
+
+    def create_module(self, spec: ModuleSpec) -> ModuleType | None:
+        _LazyLoadFinder.flush(spec.name)
+        return super().create_module(spec)
+
+
+class _LazyLoadFinder:
+    """Meta path finder that performs deferred loads before extension modules import.
+
+    The finder is only present on sys.meta_path while there are deferred loads pending.
+    It delegates the actual search to the finders following it and swaps in a loader
+    that runs the pending loads when the found module is an extension module.
+    """
+
+    # Pending loads as (loader, libraries, trigger, keyword arguments to load). The list
+    # is replaced rather than modified when loads are flushed, so that find_spec can
+    # iterate over it without holding the lock.
+    _pending: list[tuple[LibraryLoader, Sequence[str], str | None, dict]] = []
+    _lock = _thread.allocate_lock()
 
     @staticmethod
-    def _load(library_path: Path | str) -> None:
-        """Load the library at the given path with RTLD_LOCAL."""
-        ctypes.CDLL(str(library_path), mode=ctypes.RTLD_LOCAL)
+    def _matches(trigger: str | None, fullname: str) -> bool:
+        return (
+            trigger is None or fullname == trigger or fullname.startswith(trigger + ".")
+        )
 
-    def load(
-        self, libraries: Iterable[str] | None = None, *, prefer_system: bool = False
+    @classmethod
+    def defer(
+        cls,
+        loader: LibraryLoader,
+        libraries: Sequence[str],
+        trigger: str | None,
+        options: dict,
     ) -> None:
-        """Load the native library and return the ctypes.CDLL object.
+        """Record a load to perform when a matching extension module is imported."""
+        with cls._lock:
+            cls._pending = [*cls._pending, (loader, libraries, trigger, options)]
+            if cls not in sys.meta_path:
+                sys.meta_path.insert(0, cls)  # type: ignore[arg-type]
 
-        Parameters
-        ----------
-        libraries : typing.Iterable[str] | None
-            The names of the libraries to load. If None, all libraries are loaded.
-        prefer_system : bool
-            Whether or not to try loading a system library before the local version.
-            Default is False.
+    @classmethod
+    def flush(cls, fullname: str) -> None:
+        """Perform all pending loads that are triggered by the given module.
 
+        The loads stay pending until they have finished, so that extension modules
+        imported concurrently by other threads are still intercepted. Their loads then
+        wait for the libraries being opened here instead of importing too early.
         """
-        # Always load the library in local mode.
+        with cls._lock:
+            triggered = [
+                pending
+                for pending in cls._pending
+                if cls._matches(pending[2], fullname)
+            ]
+        try:
+            for loader, libraries, _, options in triggered:
+                loader.load(libraries, **options)
+        finally:
+            done = {id(pending) for pending in triggered}
+            with cls._lock:
+                cls._pending = [
+                    pending for pending in cls._pending if id(pending) not in done
+                ]
+                if not cls._pending and cls in sys.meta_path:
+                    sys.meta_path.remove(cls)  # type: ignore[arg-type]
 
-        if libraries is None:
-            libraries = self._libraries.keys()
+    @classmethod
+    def find_spec(
+        cls,
+        fullname: str,
+        path: Sequence[str] | None,
+        target: ModuleType | None = None,
+    ) -> ModuleSpec | None:
+        """Find the module with the remaining finders, intercepting extensions."""
+        if not any(cls._matches(pending[2], fullname) for pending in cls._pending):
+            return None
 
-        for library_name in libraries:
+        finders = sys.meta_path[sys.meta_path.index(cls) + 1 :]  # type: ignore[arg-type]
+        for finder in finders:
+            find_spec = getattr(finder, "find_spec", None)
+            if find_spec is None:
+                continue
+            spec = find_spec(fullname, path, target)
+            if spec is not None:
+                break
+        else:
+            return None
+
+        if isinstance(spec.loader, importlib.machinery.ExtensionFileLoader):
+            spec.loader = _PreloadingExtensionFileLoader(
+                spec.loader.name, spec.loader.path
+            )
+        return spec
+
+
+_LIBRARY_SUFFIXES = (".so", ".dylib", ".dll", ".pyd")
+
+
+def _file_sha256(path: os.PathLike | str) -> str:
+    """Compute the SHA-256 digest of a file."""
+    import hashlib
+
+    digest = hashlib.sha256()
+    buffer = bytearray(_WARMUP_CHUNK_SIZE)
+    view = memoryview(buffer)
+    with Path(path).open("rb", buffering=0) as f:
+        while size := f.readinto(buffer):
+            digest.update(view[:size])
+    return digest.hexdigest()
+
+
+def _dedupe(package_dirs: Iterable[Path]) -> tuple[list[str], list[str]]:
+    """Replace identical library files of packages with links to a single copy.
+
+    The files are grouped by the digests in the packages' manifests and only linked
+    after checking that their contents match. Hard links are used where possible,
+    which makes the dynamic loader recognize the copies as the same file, and
+    symbolic links otherwise, for example across file systems.
+
+    Returns
+    -------
+    tuple[list[str], list[str]]
+        A description of each file that was linked and of each problem found.
+
+    """
+    import json
+
+    platform_name = _platform_name()
+    groups: dict[str, list[str]] = {}
+    for package_dir in package_dirs:
+        with (package_dir / MANIFEST_NAME).open() as f:
+            manifest = json.load(f)
+        for library in manifest["libraries"].values():
+            for entry in (library, *library.get("variants", ())):
+                path = entry.get(platform_name)
+                digest = entry.get("sha256", {}).get(platform_name)
+                if path and digest:
+                    path = os.path.realpath(os.path.join(package_dir, path))
+                    paths = groups.setdefault(digest.lower(), [])
+                    if path not in paths:
+                        paths.append(path)
+
+    linked = []
+    issues = []
+    for digest, (original, *copies) in groups.items():
+        if not copies:
+            continue
+        if _file_sha256(original) != digest:
+            issues.append(f"{original} does not match its digest in the manifest")
+            continue
+        for copy in copies:
+            if os.path.samefile(original, copy):
+                continue
+            if _file_sha256(copy) != digest:
+                issues.append(f"{copy} does not match its digest in the manifest")
+                continue
+            # The link replaces the copy atomically, so that the library is never
+            # missing for a process loading it concurrently.
+            temporary = f"{copy}.{os.getpid()}.tmp"
             try:
-                library_path = self._libraries[library_name]
-            except KeyError:
-                raise ValueError(
-                    f"Library {library_name} not found in the package."
-                ) from None
-            if prefer_system or os.getenv(
-                f"PREFER_{library_name.upper()}_SYSTEM_LIBRARY", "false"
-            ).lower() not in ("false", 0):
                 try:
-                    self._load(library_path.name)
+                    os.link(original, temporary)
                 except OSError:
-                    self._load(library_path)
-            else:
-                self._load(library_path)
+                    os.symlink(original, temporary)
+                os.replace(temporary, copy)
+            except OSError as e:
+                issues.append(f"{copy} could not be linked to {original}: {e}")
+                with contextlib.suppress(OSError):
+                    os.unlink(temporary)
+                continue
+            linked.append(f"{copy} -> {original}")
+    return linked, issues
+
+
+def _relocation_report(path: str) -> list[dict]:
+    """Count the relocations of a library, or of each library in a wheel."""
+    if not path.endswith(".whl"):
+        return [{"path": path, **read_library_relocations(path)._asdict()}]
+
+    import tempfile
+    import zipfile
+
+    report = []
+    with zipfile.ZipFile(path) as wheel, tempfile.TemporaryDirectory() as directory:
+        for member in wheel.namelist():
+            name = member.rsplit("/", 1)[-1]
+            if not name.endswith(_LIBRARY_SUFFIXES) and ".so." not in name:
+                continue
+            # Libraries are parsed by mapping them, so they are extracted first.
+            relocations = read_library_relocations(wheel.extract(member, directory))
+            report.append({"path": f"{path}/{member}", **relocations._asdict()})
+    return report
+
+
+def _main(argv: Sequence[str] | None = None) -> int:
+    """Run the command line interface.
+
+    ``inspect`` prints the headers of libraries as JSON and reports libraries that the
+    loader would not record under their file name, which breaks resolving other
+    libraries' dependencies on them. ``manifest`` adds libraries, with their headers,
+    to the manifest of a package (see :meth:`LibraryLoader.from_manifest`), or with
+    ``--requires`` adds them as variants for particular CPU features.
+    ``conflicts`` reports symbol conflicts between the libraries of packages with
+    manifests (see :func:`find_conflicts`). ``relocations`` prints the relocation and
+    exported symbol counts of libraries, or of all libraries in wheels, as JSON (see
+    :func:`read_library_relocations`). ``dedupe`` links identical libraries shipped by
+    different packages to a single file, by the digests in their manifests. ``plan``
+    loads the libraries of installed modules and writes a load plan for
+    :func:`replay_load_plan` (see :func:`compile_load_plan`).
+    """
+    import argparse
+    import json
+
+    parser = argparse.ArgumentParser(
+        prog="python -m shared_lib_manager",
+        description="Inspect libraries and write library manifests.",
+    )
+    subparsers = parser.add_subparsers(dest="command", required=True)
+    inspect_parser = subparsers.add_parser(
+        "inspect", help="Print the headers of libraries and check their names."
+    )
+    inspect_parser.add_argument("paths", nargs="+", help="The library files.")
+    manifest_parser = subparsers.add_parser(
+        "manifest", help="Add libraries for the current platform to a manifest."
+    )
+    manifest_parser.add_argument(
+        "package_dir", type=Path, help="The directory of the package."
+    )
+    manifest_parser.add_argument(
+        "libraries",
+        nargs="+",
+        metavar="NAME=PATH",
+        help="The name of a library in the loader and the path to its file.",
+    )
+    manifest_parser.add_argument(
+        "--mode", choices=[mode.name for mode in LoadMode], default=None
+    )
+    manifest_parser.add_argument(
+        "--binding", choices=[binding.name for binding in BindingMode], default=None
+    )
+    manifest_parser.add_argument(
+        "--requires",
+        default=None,
+        metavar="FEATURE,...",
+        help="Add the libraries as variants that require these CPU features. "
+        "Variants are preferred in the order they are first added.",
+    )
+    conflicts_parser = subparsers.add_parser(
+        "conflicts", help="Report symbol conflicts between the libraries of packages."
+    )
+    conflicts_parser.add_argument(
+        "package_dirs",
+        nargs="+",
+        type=Path,
+        help="The directories of the packages, which must contain manifests.",
+    )
+    relocations_parser = subparsers.add_parser(
+        "relocations", help="Count the relocations and exported symbols of libraries."
+    )
+    relocations_parser.add_argument(
+        "paths", nargs="+", help="The library files, or wheels containing them."
+    )
+    dedupe_parser = subparsers.add_parser(
+        "dedupe", help="Link identical libraries of packages to a single file."
+    )
+    dedupe_parser.add_argument(
+        "package_dirs",
+        nargs="+",
+        type=Path,
+        help="The directories of the packages, which must contain manifests.",
+    )
+    plan_parser = subparsers.add_parser(
+        "plan", help="Write the load plan of the libraries of installed modules."
+    )
+    plan_parser.add_argument("plan", type=Path, help="The file to write the plan to.")
+    plan_parser.add_argument(
+        "modules",
+        nargs="*",
+        help="The modules whose libraries to load, which must ship manifests. "
+        "Defaults to all registered modules.",
+    )
+    plan_parser.add_argument(
+        "--prefer-system",
+        action="store_true",
+        help="Try loading system libraries before the local versions.",
+    )
+    args = parser.parse_args(argv)
+
+    if args.command == "plan":
+        try:
+            paths = compile_load_plan(
+                args.plan, args.modules or None, prefer_system=args.prefer_system
+            )
+        except OSError as e:
+            parser.error(str(e))
+        for path in paths:
+            print(path)
+        return 0
+
+    if args.command == "dedupe":
+        try:
+            linked, issues = _dedupe(args.package_dirs)
+        except (OSError, ValueError, KeyError, AttributeError) as e:
+            parser.error(f"Invalid library manifest: {e!r}")
+        for link in linked:
+            print(link)
+        for issue in issues:
+            print(f"warning: {issue}", file=sys.stderr)
+        return 1 if issues else 0
+
+    if args.command == "relocations":
+        report = []
+        for path in args.paths:
+            try:
+                report.extend(_relocation_report(path))
+            except (OSError, ValueError) as e:
+                parser.error(str(e))
+        print(json.dumps(report, indent=2))
+        return 0
+
+    if args.command == "conflicts":
+        loaders = []
+        for package_dir in args.package_dirs:
+            try:
+                loaders.append(LibraryLoader.from_manifest(package_dir / MANIFEST_NAME))
+            except (OSError, ValueError) as e:
+                parser.error(str(e))
+        issues = find_conflicts(loaders)
+        for issue in issues:
+            print(issue)
+        return 1 if issues else 0
+
+    if args.command == "inspect":
+        issues = []
+        report = []
+        for path in args.paths:
+            try:
+                info = read_library_info(path)
+            except (OSError, ValueError) as e:
+                issues.append(str(e))
+                continue
+            issues.extend(_library_issues(path, info))
+            report.append({"path": path, **info._asdict(), "needed": list(info.needed)})
+        print(json.dumps(report, indent=2))
+        for issue in issues:
+            print(f"warning: {issue}", file=sys.stderr)
+        return 1 if issues else 0
+
+    manifest_path = args.package_dir / MANIFEST_NAME
+    manifest: dict = {"libraries": {}}
+    if manifest_path.exists():
+        with manifest_path.open() as f:
+            manifest = json.load(f)
+    for option in ("mode", "binding"):
+        if getattr(args, option) is not None:
+            manifest[option] = getattr(args, option)
+    platform_name = _platform_name()
+    for library in args.libraries:
+        name, sep, path = library.partition("=")
+        if not sep:
+            parser.error(f"Libraries must be given as NAME=PATH, not {library}.")
+        try:
+            info = read_library_info(path)
+        except (OSError, ValueError) as e:
+            parser.error(str(e))
+        for issue in _library_issues(path, info):
+            print(f"warning: {issue}", file=sys.stderr)
+        entry = manifest["libraries"].setdefault(name, {})
+        relative_path = Path(os.path.relpath(path, args.package_dir)).as_posix()
+        if args.requires is not None:
+            # Variants share the headers recorded for the baseline build.
+            requires = sorted(set(args.requires.replace(",", " ").split()))
+            unknown = set(requires) - _CPU_FEATURE_NAMES
+            if unknown:
+                parser.error(f"Unknown CPU features {', '.join(sorted(unknown))}.")
+            variants = entry.setdefault("variants", [])
+            variant = next(
+                (variant for variant in variants if variant["requires"] == requires),
+                None,
+            )
+            if variant is None:
+                variant = {"requires": requires}
+                variants.append(variant)
+            variant[platform_name] = relative_path
+            variant.setdefault("sha256", {})[platform_name] = _file_sha256(path)
+            continue
+        entry[platform_name] = relative_path
+        entry.setdefault("sha256", {})[platform_name] = _file_sha256(path)
+        entry.setdefault("info", {})[platform_name] = {
+            **info._asdict(),
+            "needed": list(info.needed),
+        }
+    with manifest_path.open("w") as f:
+        json.dump(manifest, f, indent=4)
+        f.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(_main())
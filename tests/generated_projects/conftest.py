@@ -3,9 +3,12 @@
 
 """Common test helpers."""
 
+import json
+import platform
 import shutil
 import subprocess
 import tempfile
+from collections.abc import Iterator
 from pathlib import Path
 
 import pytest
@@ -32,6 +35,22 @@ def pytest_addoption(parser: pytest.Parser) -> None:
     parser.addoption(
         "--keep", action="store_true", help="Whether or not to persist generated files."
     )
+    parser.addoption(
+        "--benchmark-json",
+        default=None,
+        help="Run the load benchmarks and write their results to this JSON file.",
+    )
+    parser.addoption(
+        "--benchmark-repeat",
+        type=int,
+        default=5,
+        help="The number of fresh processes to time for each benchmark case.",
+    )
+    parser.addoption(
+        "--scaling-json",
+        default=None,
+        help="Run the scaling tests and write their results to this JSON file.",
+    )
 
 
 def pytest_configure(config: pytest.Config) -> None:
@@ -40,6 +59,28 @@ def pytest_configure(config: pytest.Config) -> None:
         global ENV_ROOT  # noqa: PLW0603
         ENV_ROOT = Path(tempfile.mkdtemp())
         config.add_cleanup(lambda: shutil.rmtree(ENV_ROOT))
+    config.addinivalue_line(
+        "markers", "benchmark: load latency benchmarks, run with --benchmark-json."
+    )
+    config.addinivalue_line(
+        "markers", "scaling: large environment scaling tests, run with --scaling-json."
+    )
+
+
+def pytest_collection_modifyitems(
+    config: pytest.Config, items: list[pytest.Item]
+) -> None:
+    """Skip the benchmarks and scaling tests unless their results file is given."""
+    for marker, option in (
+        ("benchmark", "--benchmark-json"),
+        ("scaling", "--scaling-json"),
+    ):
+        if config.getoption(option):
+            continue
+        skip = pytest.mark.skip(reason=f"{marker} tests only run with {option}")
+        for item in items:
+            if marker in item.keywords:
+                item.add_marker(skip)
 
 
 @pytest.fixture(scope="session")
@@ -118,14 +159,6 @@ def shared_lib_manager_wheel(
 ) -> subprocess.CompletedProcess:
     """Produce a wheel for the shared_lib_manager."""
     tmp_package_dir = create_patched_library(tmp_path_factory, MANAGER_DIR)
-
-    # Add the monkeypatching to the library.
-    # TODO: Also just add the file directly in tests so it's not in the source.
-    loader_init_file = tmp_package_dir / "shared_lib_manager.py"
-    with Path(loader_init_file).open("a") as f, Path(
-        DIR / "monkeypatch.py"
-    ).open() as mp:
-        f.write(mp.read())
     return make_wheel(package_wheelhouse, tmp_package_dir)
 
 
@@ -138,6 +171,53 @@ def shared_lib_consumer_wheel(
     return make_wheel(package_wheelhouse, tmp_package_dir)
 
 
+def write_results(path: str, results: list[dict], **metadata: object) -> None:
+    """Write test results to a JSON file along with a description of the machine.
+
+    Parameters
+    ----------
+    path : str
+        The path of the file to write.
+    results : list[dict]
+        The results to write.
+    **metadata
+        Additional settings of the session to record.
+
+    """
+    with Path(path).open("w") as f:
+        json.dump(
+            {
+                "platform": platform.platform(),
+                "machine": platform.machine(),
+                "python": platform.python_version(),
+                **metadata,
+                "results": results,
+            },
+            f,
+            indent=2,
+        )
+
+
+@pytest.fixture(scope="session")
+def benchmark_results(request: pytest.FixtureRequest) -> Iterator[list[dict]]:
+    """Collect benchmark results and write them out at the end of the session."""
+    results: list[dict] = []
+    yield results
+    write_results(
+        request.config.getoption("--benchmark-json"),
+        results,
+        repeat=request.config.getoption("--benchmark-repeat"),
+    )
+
+
+@pytest.fixture(scope="session")
+def scaling_results(request: pytest.FixtureRequest) -> Iterator[list[dict]]:
+    """Collect scaling test results and write them out at the end of the session."""
+    results: list[dict] = []
+    yield results
+    write_results(request.config.getoption("--scaling-json"), results)
+
+
 @pytest.fixture(scope="session", params=("LOCAL", "GLOBAL"))
 def load_mode(request: pytest.FixtureRequest) -> str:
     """Generate valid modes for opening a library."""
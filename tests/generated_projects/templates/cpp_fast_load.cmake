@@ -0,0 +1,29 @@
+# SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION & AFFILIATES.
+# SPDX-License-Identifier: Apache-2.0
+
+# Apply the fast-load profile to a shared library or module target. Most of the time
+# spent loading a large library goes to resolving its relocations, so the profile
+# keeps the dynamic symbol table and the relocations that need a symbol lookup small:
+#
+# - Symbols are hidden unless marked for export, so only the API is exported.
+# - -Bsymbolic-functions binds calls between functions of the library directly
+#   instead of through the PLT.
+# - --hash-style=gnu only emits the faster GNU hash table for symbol lookups.
+# - With LINK_NOW, -z now resolves every symbol when the library is loaded, which
+#   matches loading it with RTLD_NOW and makes the load time predictable.
+#
+# The linker options only apply to ELF platforms. On Windows only the marked symbols
+# are exported, and macOS already binds symbols to the library defining them.
+function({{ library_name }}_enable_fast_load target)
+  cmake_parse_arguments(PARSE_ARGV 1 fast_load "LINK_NOW" "" "")
+  set_target_properties(
+    ${target} PROPERTIES C_VISIBILITY_PRESET hidden CXX_VISIBILITY_PRESET hidden
+                         VISIBILITY_INLINES_HIDDEN ON)
+  if(UNIX AND NOT APPLE)
+    target_link_options(${target} PRIVATE "LINKER:-Bsymbolic-functions"
+                        "LINKER:--hash-style=gnu")
+    if(fast_load_LINK_NOW)
+      target_link_options(${target} PRIVATE "LINKER:-z,now")
+    endif()
+  endif()
+endfunction()
@@ -2,6 +2,9 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "{{ prefix }}example.h"
+{% if dependency %}
+#include "{{ dependency }}_example.h"
+{% endif %}
 
 int {{ prefix }}square(int x) {
   {% if square_as_cube %}
@@ -10,3 +13,28 @@ int {{ prefix }}square(int x) {
     return x * x;
   {% endif %}
 }
+
+{# Each symbol calls the previous one through the PLT so that every extra symbol adds a
+   relocation for the dynamic loader to resolve, which is what distinguishes lazy from
+   immediate binding. #}
+{% for i in range(num_symbols) %}
+int {{ prefix }}symbol_{{ i }}(int x) {
+  {% if i %}
+    return {{ prefix }}symbol_{{ i - 1 }}(x) + 1;
+  {% else %}
+    return x;
+  {% endif %}
+}
+{% endfor %}
+
+{% if chain %}
+{# The libraries of a chain each call into the library before them, so that each one
+   can only be loaded after its dependency and the depth shows which copy was found. #}
+int {{ prefix }}depth(void) {
+  {% if dependency %}
+    return {{ dependency }}_depth() + 1;
+  {% else %}
+    return 1;
+  {% endif %}
+}
+{% endif %}
@@ -1,4 +1,26 @@
 // SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION & AFFILIATES.
 // SPDX-License-Identifier: Apache-2.0
 
-int {{ prefix }}square(int x);
+{% set api = (prefix ~ "example_api") | upper %}
+// Mark the functions exported by the library so that it still exports them when
+// everything else is hidden, as in the fast-load profile. Consumers do not use
+// dllimport so that they link the same way with either profile.
+#ifndef {{ api }}
+#if defined(_WIN32)
+#ifdef {{ (prefix ~ "example_building") | upper }}
+#define {{ api }} __declspec(dllexport)
+#else
+#define {{ api }}
+#endif
+#else
+#define {{ api }} __attribute__((visibility("default")))
+#endif
+#endif
+
+{{ api }} int {{ prefix }}square(int x);
+{% for i in range(num_symbols) %}
+{{ api }} int {{ prefix }}symbol_{{ i }}(int x);
+{% endfor %}
+{% if chain %}
+{{ api }} int {{ prefix }}depth(void);
+{% endif %}
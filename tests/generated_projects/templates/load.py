@@ -13,10 +13,14 @@ loader = shared_lib_manager.LibraryLoader(
             Linux=os.path.join(root, "lib", "lib{{ library_name }}.so"),
             Darwin=os.path.join(root, "lib", "lib{{ library_name }}.dylib"),
             Windows=os.path.join(root, "lib", "{{ library_name }}.dll"),
+{% if library_name in dependencies %}
+            depends_on={{ dependencies[library_name] }},
+{% endif %}
         ),
 {% endfor %}
     },
     mode=shared_lib_manager.LoadMode.{{ load_mode }},
+    binding=shared_lib_manager.BindingMode.{{ binding }},
 )
 
 __all__ = [
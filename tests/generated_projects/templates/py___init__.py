@@ -3,8 +3,12 @@
 
 {% if load_dynamic_lib %}
 import shared_lib_consumer
+{% if lazy_load %}
+shared_lib_consumer.load_library_module("{{ cpp_package_name }}", lazy=True, trigger=__name__)
+{% else %}
 shared_lib_consumer.load_library_module("{{ cpp_package_name }}")
 {% endif %}
+{% endif %}
 
 from . import {{ package_name }}  # noqa: E402
 
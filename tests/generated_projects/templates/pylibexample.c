@@ -15,11 +15,20 @@ static PyObject *{{ prefix }}square_wrapper(PyObject *self, PyObject *args) {
   }
   return PyFloat_FromDouble({{ prefix }}square(input));
 }
+{% if chain %}
+
+static PyObject *{{ prefix }}depth_wrapper(PyObject *self, PyObject *args) {
+  return PyLong_FromLong({{ prefix }}depth());
+}
+{% endif %}
 {% endfor %}
 
 static PyMethodDef {{ package_name }}_methods[] = {
 {% for prefix in prefixes %}
     {"{{ prefix }}square", {{ prefix }}square_wrapper, METH_VARARGS, "Square function"},
+{% if chain %}
+    {"{{ prefix }}depth", {{ prefix }}depth_wrapper, METH_NOARGS, "Depth function"},
+{% endif %}
 {% endfor %}
     {NULL, NULL, 0, NULL}};
 
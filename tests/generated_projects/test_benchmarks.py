@@ -0,0 +1,228 @@
+# SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION & AFFILIATES.
+# SPDX-License-Identifier: Apache-2.0
+
+"""Benchmark the latency of loading generated libraries and calling into them.
+
+These tests are skipped unless ``--benchmark-json`` is passed, in which case the
+timings of every case are written to that file. Each sample is taken in a fresh
+interpreter and measures the time from importing the library package to the first
+call into the extension module that uses it.
+"""
+
+from __future__ import annotations
+
+import json
+import os
+import statistics
+from pathlib import Path
+from typing import TYPE_CHECKING
+
+import pytest
+from test_generated_projects import VEnv, dir_test, make_cpp_pkg, make_python_pkg, names
+
+if TYPE_CHECKING:
+    from collections.abc import Callable
+
+NATIVE_SUFFIXES = (".so", ".dylib", ".dll", ".pyd")
+
+# The loader is configured and timed explicitly instead of through the generated
+# package __init__ so that options like parallel loading can be varied.
+BENCHMARK_SCRIPT = """
+    import json
+    import time
+
+    start = time.perf_counter()
+    import {cpp_package_name}
+    {cpp_package_name}.loader.load(parallel={parallel})
+    loaded = time.perf_counter()
+    import {python_package_name}
+    {python_package_name}.{python_package_name}.{function}(4)
+    end = time.perf_counter()
+
+    import shared_lib_manager
+    print(
+        json.dumps(
+            {{
+                "load": loaded - start,
+                "total": end - start,
+                "native": shared_lib_manager._native is not None,
+            }}
+        )
+    )
+"""
+
+FIND_PACKAGES_SCRIPT = """
+    import importlib.util
+    import json
+
+    print(
+        json.dumps(
+            [
+                importlib.util.find_spec(name).submodule_search_locations[0]
+                for name in {package_names!r}
+            ]
+        )
+    )
+"""
+
+RELOCATIONS_SCRIPT = """
+    import shared_lib_manager
+
+    shared_lib_manager._main(["relocations", {wheel!r}])
+"""
+
+
+def evict_from_page_cache(paths: list[Path]) -> None:
+    """Drop the cached pages of the given files so that the next load reads them.
+
+    Parameters
+    ----------
+    paths : list[Path]
+        The files to evict.
+
+    """
+    for path in paths:
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            # Dirty pages cannot be dropped, so make sure they are written out first.
+            os.fsync(fd)
+            os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+        finally:
+            os.close(fd)
+
+
+def time_script(
+    env: VEnv, script: str, repeat: int, prepare: Callable[[], None] | None = None
+) -> list[dict]:
+    """Run a benchmark script in fresh processes and collect its timings.
+
+    Parameters
+    ----------
+    env : VEnv
+        The environment to run the script in.
+    script : str
+        The benchmark script, which prints its timings as JSON.
+    repeat : int
+        The number of samples to take.
+    prepare : Callable[[], None], optional
+        A function to call before taking each sample.
+
+    """
+    samples = []
+    for _ in range(repeat):
+        if prepare is not None:
+            prepare()
+        samples.append(json.loads(env.run(script).stdout))
+    return samples
+
+
+@pytest.mark.benchmark
+@pytest.mark.parametrize("fast_load", [False, True])
+@pytest.mark.parametrize("binding", ["NOW", "LAZY"])
+@pytest.mark.parametrize("num_symbols", [16, 4096])
+@pytest.mark.parametrize("num_libraries", [1, 8])
+def test_load_latency(  # noqa: PLR0913
+    num_libraries: int,
+    num_symbols: int,
+    binding: str,
+    fast_load: bool,  # noqa: FBT001
+    package_wheelhouse: Path,
+    benchmark_results: list[dict],
+    request: pytest.FixtureRequest,
+) -> None:
+    """Time loading a package of generated libraries with cold and warm caches.
+
+    The relocation counts of the libraries are recorded with the timings to show what
+    the fast-load build profile saves.
+    """
+    root = dir_test(
+        "benchmark",
+        num_libraries=str(num_libraries),
+        num_symbols=str(num_symbols),
+        binding=binding,
+        fast_load=str(fast_load),
+    )
+    base_name, cpp_package_name, python_package_name = names("bench")
+    library_names = [f"{base_name}_{i}" for i in range(num_libraries)]
+    make_cpp_pkg(
+        root,
+        cpp_package_name,
+        library_names,
+        "LOCAL",
+        binding=binding,
+        num_symbols=num_symbols,
+        fast_load=fast_load,
+    )
+    make_python_pkg(
+        root,
+        python_package_name,
+        library_names,
+        cpp_package_name,
+        dependencies=[cpp_package_name],
+        build_dependencies=["scikit-build-core", cpp_package_name],
+        load_dynamic_lib=False,
+    )
+
+    env = VEnv(root, package_wheelhouse)
+    env.build_wheels([root / cpp_package_name, root / python_package_name])
+    env.install(python_package_name, "--no-index")
+
+    package_dirs = json.loads(
+        env.run(
+            FIND_PACKAGES_SCRIPT.format(
+                package_names=[cpp_package_name, python_package_name]
+            )
+        ).stdout
+    )
+    native_files = [
+        path
+        for package_dir in package_dirs
+        for path in Path(package_dir).rglob("*")
+        if path.suffix in NATIVE_SUFFIXES
+    ]
+
+    (wheel,) = Path(env.wheelhouse).glob(f"{cpp_package_name}-*.whl")
+    relocations = json.loads(
+        env.run(RELOCATIONS_SCRIPT.format(wheel=str(wheel))).stdout
+    )
+
+    caches = ["warm"]
+    if hasattr(os, "posix_fadvise"):
+        caches.append("cold")
+    repeat = request.config.getoption("--benchmark-repeat")
+    function = f"{library_names[0]}_square" if num_libraries > 1 else "square"
+    for parallel in (False, True):
+        script = BENCHMARK_SCRIPT.format(
+            cpp_package_name=cpp_package_name,
+            python_package_name=python_package_name,
+            function=function,
+            parallel=parallel,
+        )
+        for cache in caches:
+            if cache == "warm":
+                # Populate the page cache before the timed runs.
+                env.run(script)
+                samples = time_script(env, script, repeat)
+            else:
+                samples = time_script(
+                    env, script, repeat, lambda: evict_from_page_cache(native_files)
+                )
+            totals = [sample["total"] for sample in samples]
+            benchmark_results.append(
+                {
+                    "num_libraries": num_libraries,
+                    "num_symbols": num_symbols,
+                    "binding": binding,
+                    "fast_load": fast_load,
+                    "parallel": parallel,
+                    "cache": cache,
+                    "native": samples[0]["native"],
+                    "median_load": statistics.median(
+                        sample["load"] for sample in samples
+                    ),
+                    "median_total": statistics.median(totals),
+                    "min_total": min(totals),
+                    "samples": samples,
+                    "relocations": relocations,
+                }
+            )
@@ -8,18 +8,24 @@ from __future__ import annotations
 import contextlib
 import hashlib
 import json
+import os
 import platform
+import shutil
 import subprocess
 import sys
 import tempfile
 import textwrap
 import venv
+from concurrent.futures import ThreadPoolExecutor
 from functools import lru_cache
 from pathlib import Path
 from typing import TYPE_CHECKING
 
 import pytest
+import tomlkit
 from jinja2 import Environment, FileSystemLoader
+from packaging.requirements import Requirement
+from packaging.utils import canonicalize_name
 
 if TYPE_CHECKING:
     from os import PathLike
@@ -28,6 +34,116 @@ from conftest import DIR, ENV_ROOT
 
 sys.path.insert(0, str(DIR))
 
+# Wheels are cached across tests by the hash of everything that goes into them, and
+# new environments are copied from a base environment that already has a current pip.
+WHEEL_CACHE = ENV_ROOT / "wheel_cache"
+BASE_ENV = ENV_ROOT / "base_env"
+PIP_CACHE = ENV_ROOT / "pip_cache"
+
+# Directories that building a package may write into its source tree.
+IGNORED_SOURCE_DIRS = frozenset(("build", "dist", "__pycache__"))
+
+
+def python_executable(env_dir: Path) -> Path:
+    """Get the path to the Python executable of a virtual environment.
+
+    Parameters
+    ----------
+    env_dir : Path
+        The directory of the virtual environment.
+
+    """
+    if platform.system() == "Windows":
+        return env_dir / "Scripts" / "python.exe"
+    return env_dir / "bin" / "python"
+
+
+@lru_cache
+def base_env() -> Path:
+    """Create the environment that the environments of all tests are copied from.
+
+    The environment is created under a temporary name and then renamed so that
+    concurrent sessions sharing a persistent root never see a partial environment.
+    """
+    if not python_executable(BASE_ENV).exists():
+        ENV_ROOT.mkdir(parents=True, exist_ok=True)
+        tmp_dir = Path(tempfile.mkdtemp(dir=ENV_ROOT))
+        venv.create(tmp_dir, clear=True, with_pip=True)
+        # Always update pip to ensure that we have the necessary new features like
+        # config-settings.
+        subprocess.run(
+            [
+                python_executable(tmp_dir),
+                "-m",
+                "pip",
+                "--disable-pip-version-check",
+                "--cache-dir",
+                PIP_CACHE,
+                "install",
+                "-U",
+                "pip",
+            ],
+            check=True,
+        )
+        try:
+            tmp_dir.rename(BASE_ENV)
+        except OSError:
+            shutil.rmtree(tmp_dir)
+    return BASE_ENV
+
+
+def hash_package(package_dir: Path, *inputs: str) -> str:
+    """Hash the rendered sources of a package together with other build inputs.
+
+    Parameters
+    ----------
+    package_dir : Path
+        The directory containing the package.
+    *inputs
+        Additional strings that affect the build.
+
+    Returns
+    -------
+    str
+        The hex digest of the hash.
+
+    """
+    hasher = hashlib.sha256()
+    for path in sorted(package_dir.rglob("*")):
+        relative = path.relative_to(package_dir)
+        if not path.is_file() or IGNORED_SOURCE_DIRS.intersection(relative.parts):
+            continue
+        hasher.update(relative.as_posix().encode())
+        hasher.update(b"\0")
+        hasher.update(path.read_bytes())
+        hasher.update(b"\0")
+    for value in inputs:
+        hasher.update(value.encode())
+        hasher.update(b"\0")
+    return hasher.hexdigest()
+
+
+def read_build_metadata(package_dir: Path) -> tuple[str, list[str]]:
+    """Get the name and build requirements of a package.
+
+    Parameters
+    ----------
+    package_dir : Path
+        The directory containing the package.
+
+    Returns
+    -------
+    tuple[str, list[str]]
+        The normalized name of the package and of each of its build requirements.
+
+    """
+    with Path(package_dir / "pyproject.toml").open() as f:
+        pyproject = tomlkit.load(f)
+    return canonicalize_name(pyproject["project"]["name"]), [
+        canonicalize_name(Requirement(requirement).name)
+        for requirement in pyproject["build-system"]["requires"]
+    ]
+
 
 class VEnv:
     """Convenience class for managing a virtual environment for testing.
@@ -41,25 +157,20 @@ class VEnv:
 
     def __init__(self, root: Path, package_wheelhouse: Path):
         self.env_dir = root / "env"
-        Path(self.env_dir).mkdir(exist_ok=True)
 
         self.nll_wheelhouse = str(package_wheelhouse)
         self.wheelhouse = str(root / "wheelhouse")
-        self.cache_dir = str(root / "cache")
+        # The pip cache is shared so that build requirements are only downloaded once.
+        self.cache_dir = str(PIP_CACHE)
 
-        self.executable = (
-            str(Path(self.env_dir) / "bin" / "python")
-            if platform.system() != "Windows"
-            else str(Path(self.env_dir) / "Scripts" / "python.exe")
-        )
+        self.executable = str(python_executable(self.env_dir))
         # Allow for rerunning the script on preexisting test directories for local
-        # debugging and interactive exploration.
+        # debugging and interactive exploration. Copying the base environment is much
+        # faster than creating one and updating its pip, and is safe because pip is
+        # always run as a module rather than through its relocated entry points.
         if not Path(self.executable).exists():
-            venv.create(
-                self.env_dir,
-                clear=True,
-                with_pip=True,
-            )
+            shutil.rmtree(self.env_dir, ignore_errors=True)
+            shutil.copytree(base_env(), self.env_dir, symlinks=True)
 
         self._pip_cmd_base: list[str] = [
             self.executable,
@@ -69,9 +180,9 @@ class VEnv:
             "--cache-dir",
             self.cache_dir,
         ]
-        # Always update pip to ensure that we have the necessary new features like
-        # config-settings.
-        self.install("pip", "-U")
+        # The cache keys of the wheels built in this environment by package name,
+        # which are part of the keys of the packages that build against them.
+        self._wheel_keys: dict[str, str] = {}
 
     def install(
         self, package_name: Path | str, *args: str, editable: bool = False
@@ -113,6 +224,12 @@ class VEnv:
     ) -> subprocess.CompletedProcess:
         """Build a wheel with `pip wheel`.
 
+        Wheels are stored in a cache shared by all tests, keyed by the hash of the
+        rendered package sources and of the wheels of any packages built in this
+        environment that it requires to build. A cached wheel is copied into the
+        wheelhouse instead of being rebuilt. Builds passed extra arguments are not
+        cached since those may refer to inputs outside of the package directory.
+
         Parameters
         ----------
         package_dir : PathLike or str
@@ -121,32 +238,114 @@ class VEnv:
             Arguments to pass to `pip install`.
 
         """
-        return subprocess.run(
-            [
-                *self._pip_cmd_base,
-                *(
-                    "wheel",
-                    "--no-deps",
-                    "--wheel-dir",
-                    self.wheelhouse,
-                    "--find-links",
-                    self.nll_wheelhouse,
-                    "--find-links",
-                    self.wheelhouse,
-                    package_dir,
-                    *args,
-                ),
-            ],
-            check=True,
+        package_dir = Path(package_dir)
+        name, build_requirements = read_build_metadata(package_dir)
+        key = hash_package(
+            package_dir,
+            *(
+                f"{requirement}={self._wheel_keys.get(requirement)}"
+                for requirement in sorted(build_requirements)
+            ),
         )
+        cached = WHEEL_CACHE / key
+
+        cmd = [
+            *self._pip_cmd_base,
+            "wheel",
+            "--no-deps",
+            "--wheel-dir",
+            self.wheelhouse,
+            "--find-links",
+            self.nll_wheelhouse,
+            "--find-links",
+            self.wheelhouse,
+            package_dir,
+            *args,
+        ]
+        if args:
+            self._wheel_keys.pop(name, None)
+            return subprocess.run(cmd, check=True)
+
+        if not cached.is_dir():
+            WHEEL_CACHE.mkdir(parents=True, exist_ok=True)
+            tmp_dir = Path(tempfile.mkdtemp(dir=WHEEL_CACHE))
+            cmd[cmd.index("--wheel-dir") + 1] = tmp_dir
+            try:
+                subprocess.run(cmd, check=True)
+            except subprocess.CalledProcessError:
+                shutil.rmtree(tmp_dir)
+                raise
+            try:
+                tmp_dir.rename(cached)
+            except OSError:
+                # Another session stored the same wheel first.
+                shutil.rmtree(tmp_dir)
+        Path(self.wheelhouse).mkdir(parents=True, exist_ok=True)
+        for wheel in cached.glob("*.whl"):
+            shutil.copy2(wheel, self.wheelhouse)
+        self._wheel_keys[name] = key
+        return subprocess.CompletedProcess(cmd, 0)
+
+    def build_wheels(
+        self, package_dirs: list[PathLike | str]
+    ) -> list[subprocess.CompletedProcess]:
+        """Build the wheels of several packages in parallel.
+
+        Packages that require other packages in the list to build are built after
+        them, and all packages whose requirements have been built are built at once.
 
-    def run(self, code: str) -> subprocess.CompletedProcess:
+        Parameters
+        ----------
+        package_dirs : list[PathLike or str]
+            The directories containing the packages to build.
+
+        Returns
+        -------
+        list[subprocess.CompletedProcess]
+            The result of building each package, in the order they were given.
+
+        """
+        package_dirs = [Path(package_dir) for package_dir in package_dirs]
+        metadata = dict(map(read_build_metadata, package_dirs))
+        levels: dict[str, int] = {}
+
+        def level(name: str, seen: frozenset[str] = frozenset()) -> int:
+            if name in seen:
+                raise ValueError(f"Cyclic build requirements through {name}")
+            if name not in levels:
+                levels[name] = 1 + max(
+                    (
+                        level(requirement, seen | {name})
+                        for requirement in metadata[name]
+                        if requirement in metadata
+                    ),
+                    default=-1,
+                )
+            return levels[name]
+
+        package_levels = [level(name) for name in metadata]
+        results: dict[Path, subprocess.CompletedProcess] = {}
+        with ThreadPoolExecutor(max_workers=os.cpu_count()) as executor:
+            for current in sorted(set(package_levels)):
+                batch = [
+                    package_dir
+                    for package_dir, package_level in zip(package_dirs, package_levels)
+                    if package_level == current
+                ]
+                results.update(zip(batch, executor.map(self.wheel, batch)))
+        return [results[package_dir] for package_dir in package_dirs]
+
+    def run(
+        self, code: str, env: dict[str, str] | None = None
+    ) -> subprocess.CompletedProcess:
         """Run Python code in the virtual environment.
 
         Parameters
         ----------
         code : str
             The Python code to run.
+        env : dict[str, str], optional
+            Environment variables to set in addition to the current environment.
 
         """
         # To support Windows (prior to 3.12 when the delete_on_close parameter
@@ -162,7 +361,10 @@ class VEnv:
         f.close()
         try:
             return subprocess.run(
-                [self.executable, f.name], capture_output=True, check=True
+                [self.executable, f.name],
+                capture_output=True,
+                check=True,
+                env={**os.environ, **env} if env is not None else None,
             )
         finally:
             Path(f.name).unlink()
@@ -225,12 +427,17 @@ def generate_from_template(
         f.write(content)
 
 
-def make_cpp_lib(
+def make_cpp_lib(  # noqa: PLR0913
     root: PathLike | str,
     library_name: str,
     *,
     square_as_cube: bool = False,
     prefix: str = "",
+    num_symbols: int = 0,
+    fast_load: bool = False,
+    link_now: bool = False,
+    chain: bool = False,
+    dependency: str | None = None,
 ) -> None:
     """Generate a standard C++ library with a CMake build system.
 
@@ -244,6 +451,21 @@ def make_cpp_lib(
         Whether to implement the square function as a cube function.
     prefix : str, optional
         A prefix to add to the function names.
+    num_symbols : int, optional
+        The number of additional exported functions to generate. Each one calls the
+        previous one so that it requires a relocation at load time.
+    fast_load : bool, optional
+        Whether to build the library with the fast-load profile, which only exports
+        its API and minimizes the relocations resolved at load time.
+    link_now : bool, optional
+        Whether the fast-load profile links the library with ``-z now``.
+    chain : bool, optional
+        Whether the library is part of a dependency chain, in which case it exports a
+        depth function returning its position in the chain.
+    dependency : str, optional
+        The name of the library before this one in the chain, which this library
+        links to and calls into. Libraries in a chain must use their name followed
+        by an underscore as their prefix.
 
     """
     root = Path(root)
@@ -260,6 +482,9 @@ def make_cpp_lib(
         {
             "library_name": library_name,
             "prefix": prefix,
+            "fast_load": fast_load,
+            "link_now": link_now,
+            "dependency": dependency,
         },
     )
     generate_from_template(
@@ -267,27 +492,46 @@ def make_cpp_lib(
         "example.h",
         {
             "prefix": prefix,
+            "num_symbols": num_symbols,
+            "chain": chain,
         },
     )
     generate_from_template(
         lib_src_dir / "example.c",
         "example.c",
-        {"prefix": prefix, "square_as_cube": square_as_cube},
+        {
+            "prefix": prefix,
+            "square_as_cube": square_as_cube,
+            "num_symbols": num_symbols,
+            "chain": chain,
+            "dependency": dependency,
+        },
     )
     generate_from_template(
         lib_cmake_dir / "config.cmake.in",
         "cpp_config.cmake.in",
         {"library_name": library_name},
     )
+    generate_from_template(
+        lib_cmake_dir / "fast_load.cmake",
+        "cpp_fast_load.cmake",
+        {"library_name": library_name},
+    )
 
 
-def make_cpp_pkg(
+def make_cpp_pkg(  # noqa: PLR0913
     root: PathLike | str,
     package_name: str,
     library_names: str | list[str],
     load_mode: str,
     *,
     square_as_cube: bool = False,
+    binding: str = "NOW",
+    num_symbols: int = 0,
+    fast_load: bool = False,
+    link_now: bool = False,
+    chain: bool = False,
+    manifest: bool = True,
 ) -> None:
     """Generate a Python package exporting a native library.
 
@@ -303,6 +547,20 @@ def make_cpp_pkg(
         The load mode used.
     square_as_cube : bool, optional
         Whether to implement the square function as a cube function.
+    binding : str, optional
+        The binding mode used.
+    num_symbols : int, optional
+        The number of additional exported functions in each library.
+    fast_load : bool, optional
+        Whether to build the libraries with the fast-load profile.
+    link_now : bool, optional
+        Whether the fast-load profile links the libraries with ``-z now``.
+    chain : bool, optional
+        Whether each library depends on the one before it in ``library_names``,
+        forming a dependency chain that must be loaded in order.
+    manifest : bool, optional
+        Whether the package ships a library manifest next to its ``load.py``. Without
+        one consumers import the package to get its loader.
 
     """
     root = Path(root)
@@ -334,15 +592,33 @@ def make_cpp_pkg(
     if load_mode not in ("LOCAL", "GLOBAL", "ENV"):
         msg = f"Invalid load mode: {load_mode}"
         raise ValueError(msg)
-    generate_from_template(
-        lib_dir / "load.py",
-        "load.py",
-        {"library_names": library_names, "load_mode": load_mode},
+    if binding not in ("NOW", "LAZY"):
+        msg = f"Invalid binding mode: {binding}"
+        raise ValueError(msg)
+    dependencies = (
+        {
+            library_name: [dependency]
+            for dependency, library_name in zip(library_names, library_names[1:])
+        }
+        if chain
+        else {}
     )
+    outputs = ["load.py", "shared_libs.json"] if manifest else ["load.py"]
+    for output_name in outputs:
+        generate_from_template(
+            lib_dir / output_name,
+            output_name,
+            {
+                "library_names": library_names,
+                "load_mode": load_mode,
+                "binding": binding,
+                "dependencies": dependencies,
+            },
+        )
 
-    use_prefix = len(library_names) > 1
+    use_prefix = len(library_names) > 1 or chain
     prefix = ""
-    for library_name in library_names:
+    for i, library_name in enumerate(library_names):
         if use_prefix:
             prefix = f"{library_name}_"
         make_cpp_lib(
@@ -350,6 +626,11 @@ def make_cpp_pkg(
             library_name,
             square_as_cube=square_as_cube,
             prefix=prefix,
+            num_symbols=num_symbols,
+            fast_load=fast_load,
+            link_now=link_now,
+            chain=chain,
+            dependency=library_names[i - 1] if chain and i else None,
         )
 
 
@@ -362,8 +643,10 @@ def make_python_pkg(  # noqa: PLR0913
     dependencies: list | None = None,
     build_dependencies: list | None = None,
     load_dynamic_lib: bool = True,
+    lazy_load: bool = False,
     set_rpath: bool = False,
     windows_unresolved_symbols: bool = False,
+    chain: bool = False,
 ) -> None:
     """Generate a Python package with a native library dependency.
 
@@ -383,11 +666,17 @@ def make_python_pkg(  # noqa: PLR0913
         The build dependencies for the package.
     load_dynamic_lib : bool, optional
         Whether to load the dynamic library.
+    lazy_load : bool, optional
+        Whether to defer loading the dynamic library until the extension module is
+        imported.
     set_rpath : bool, optional
         Whether to set the rpath for the Python extension module.
     windows_unresolved_symbols: bool, optional
         Whether to avoid linking to the C++ library on the link line to test
         unresolved symbol resolution on Windows.
+    chain : bool, optional
+        Whether the libraries were generated as dependency chains, in which case the
+        extension module also exposes the depth function of each library.
 
     """
     root = Path(root)
@@ -435,11 +724,12 @@ def make_python_pkg(  # noqa: PLR0913
             "dependencies": dependencies,
             "build_dependencies": build_dependencies,
             "load_dynamic_lib": load_dynamic_lib,
+            "lazy_load": lazy_load,
         },
     )
     prefixes = (
         [""]
-        if len(library_names) == 1
+        if len(library_names) == 1 and not chain
         else [f"{library_name}_" for library_name in library_names]
     )
     generate_from_template(
@@ -450,6 +740,7 @@ def make_python_pkg(  # noqa: PLR0913
             "package_name": package_name,
             "dependencies": dependencies,
             "build_dependencies": build_dependencies,
+            "chain": chain,
         },
     )
 
@@ -518,15 +809,17 @@ def names(base_name: str) -> tuple[str, str, str]:
 #############################################
 # Test cases
 #############################################
-def basic_test(
+def basic_test(  # noqa: PLR0913
     package_wheelhouse: Path,
     *,
     load_mode: str = "GLOBAL",
     load_dynamic_lib: bool = True,
+    lazy_load: bool = False,
     set_rpath: bool = False,
     python_editable: bool = False,
     windows_unresolved_symbols: bool = False,
-) -> None:
+    manifest: bool = True,
+) -> VEnv:
     """Test the generation of a basic library with a C++ and Python package.
 
     In this case everything is largely expected to work. It's a single library with a
@@ -540,6 +833,9 @@ def basic_test(
         The load mode used.
     load_dynamic_lib : bool
         Whether the Python package should dynamically load the native library.
+    lazy_load : bool
+        Whether the Python package should defer loading until the extension module is
+        imported.
     set_rpath : bool
         Whether the Python extension module should set the rpath.
     python_editable : bool
@@ -547,18 +843,34 @@ def basic_test(
     windows_unresolved_symbols: bool, optional
         Whether to avoid linking to the C++ library on the link line to test
         unresolved symbol resolution on Windows.
+    manifest : bool, optional
+        Whether the C++ package ships a library manifest.
+
+    Returns
+    -------
+    VEnv
+        The environment in which the packages are installed.
 
     """
     root = dir_test(
         "basic_lib",
         load_mode=load_mode,
         load_dynamic_lib=str(load_dynamic_lib),
+        lazy_load=str(lazy_load),
         set_rpath=str(set_rpath),
         python_editable=str(python_editable),
         windows_unresolved_symbols=str(windows_unresolved_symbols),
+        manifest=str(manifest),
     )
     library_name, cpp_package_name, python_package_name = names("example")
-    make_cpp_pkg(root, cpp_package_name, library_name, load_mode, square_as_cube=False)
+    make_cpp_pkg(
+        root,
+        cpp_package_name,
+        library_name,
+        load_mode,
+        square_as_cube=False,
+        manifest=manifest,
+    )
     make_python_pkg(
         root,
         python_package_name,
@@ -567,16 +879,17 @@ def basic_test(
         dependencies=["shared_lib_consumer", "libexample"],
         build_dependencies=["scikit-build-core", "libexample"],
         load_dynamic_lib=load_dynamic_lib,
+        lazy_load=lazy_load,
         set_rpath=set_rpath,
         windows_unresolved_symbols=windows_unresolved_symbols,
     )
 
     env = VEnv(root, package_wheelhouse)
-    env.wheel(root / cpp_package_name)
     if python_editable:
+        env.wheel(root / cpp_package_name)
         env.install(root / python_package_name, editable=python_editable)
     else:
-        env.wheel(root / python_package_name)
+        env.build_wheels([root / cpp_package_name, root / python_package_name])
         env.install(python_package_name, "--no-index", editable=python_editable)
     env.run(
         """
@@ -585,6 +898,17 @@ def basic_test(
         assert pylibexample.pylibexample.square(4) == 16
         """,
     )
+    return env
+
+
+@pytest.fixture(scope="module")
+def local_env(package_wheelhouse: Path) -> VEnv:
+    """Produce the environment of the basic test with local loads.
+
+    The environment is shared by the tests of behaviors that do not depend on how the
+    packages are built, so that it is only built and installed once.
+    """
+    return basic_test(package_wheelhouse, load_mode="LOCAL")
 
 
 def two_libraries_in_package_test(
@@ -595,6 +919,7 @@ def two_libraries_in_package_test(
     set_rpath: bool = False,
     python_editable: bool = False,
     windows_unresolved_symbols: bool = False,
+    manifest: bool = True,
 ) -> None:
     """Test where the C++ package contains two libraries.
 
@@ -613,6 +938,8 @@ def two_libraries_in_package_test(
     windows_unresolved_symbols: bool, optional
         Whether to avoid linking to the C++ library on the link line to test
         unresolved symbol resolution on Windows.
+    manifest : bool, optional
+        Whether the C++ package ships a library manifest.
 
     """
     root = dir_test(
@@ -622,10 +949,18 @@ def two_libraries_in_package_test(
         set_rpath=str(set_rpath),
         python_editable=str(python_editable),
         windows_unresolved_symbols=str(windows_unresolved_symbols),
+        manifest=str(manifest),
     )
     library_name, cpp_package_name, python_package_name = names("example")
     library_names = [f"{library_name}_1", f"{library_name}_2"]
-    make_cpp_pkg(root, cpp_package_name, library_names, load_mode, square_as_cube=False)
+    make_cpp_pkg(
+        root,
+        cpp_package_name,
+        library_names,
+        load_mode,
+        square_as_cube=False,
+        manifest=manifest,
+    )
     make_python_pkg(
         root,
         python_package_name,
@@ -639,11 +974,11 @@ def two_libraries_in_package_test(
     )
 
     env = VEnv(root, package_wheelhouse)
-    env.wheel(root / cpp_package_name)
     if python_editable:
+        env.wheel(root / cpp_package_name)
         env.install(root / python_package_name, editable=python_editable)
     else:
-        env.wheel(root / python_package_name)
+        env.build_wheels([root / cpp_package_name, root / python_package_name])
         env.install(python_package_name, "--no-index", editable=python_editable)
     env.run(
         """
@@ -662,7 +997,7 @@ def two_colliding_packages_test(
     load_mode: str = "GLOBAL",
     load_dynamic_lib: bool = True,
     set_rpath: bool = False,
-) -> None:
+) -> VEnv:
     """Test using two libraries with symbol collisions.
 
     This test should work when loading locally, but global loads should collide.
@@ -678,6 +1013,11 @@ def two_colliding_packages_test(
     set_rpath : bool
         Whether the Python extension module should set the rpath.
 
+    Returns
+    -------
+    VEnv
+        The environment in which the packages are installed.
+
     """
     root = dir_test(
         "two_colliding_packages",
@@ -716,12 +1056,15 @@ def two_colliding_packages_test(
     )
 
     env = VEnv(root, package_wheelhouse)
-    env.wheel(root / foo_cpp_package_name)
-    env.wheel(root / foo_python_package_name)
+    env.build_wheels(
+        [
+            root / foo_cpp_package_name,
+            root / foo_python_package_name,
+            root / bar_cpp_package_name,
+            root / bar_python_package_name,
+        ]
+    )
     env.install(foo_python_package_name, "--no-index")
-
-    env.wheel(root / bar_cpp_package_name)
-    env.wheel(root / bar_python_package_name)
     env.install(bar_python_package_name, "--no-index")
 
     env.run(
@@ -734,16 +1077,1175 @@ def two_colliding_packages_test(
         assert pylibbar.pylibbar.square(4) == 64
         """,
     )
+    return env
 
 
-def test_basic(load_mode: str, package_wheelhouse: Path) -> None:
-    """Test a single Python extension loading an associated library."""
-    basic_test(package_wheelhouse, load_mode=load_mode)
+@pytest.mark.parametrize("manifest", [True, False])
+def test_basic(
+    load_mode: str,
+    manifest: bool,  # noqa: FBT001
+    package_wheelhouse: Path,
+) -> None:
+    """Test a single Python extension loading an associated library.
+
+    Without a manifest the consumer imports the C++ package to get its loader.
+    """
+    basic_test(package_wheelhouse, load_mode=load_mode, manifest=manifest)
 
 
-def test_two_libraries_in_package(load_mode: str, package_wheelhouse: Path) -> None:
+@pytest.mark.parametrize("manifest", [True, False])
+def test_lazy_load(
+    load_mode: str,
+    manifest: bool,  # noqa: FBT001
+    package_wheelhouse: Path,
+) -> None:
+    """Test deferring the library load until the extension module is imported."""
+    env = basic_test(
+        package_wheelhouse, load_mode=load_mode, lazy_load=True, manifest=manifest
+    )
+    env.run(
+        """
+        import shared_lib_consumer
+        import shared_lib_manager
+
+        # The package defers the load and then imports its extension module, so the
+        # state in between is recorded just after the deferred load returns.
+        deferred = []
+        load_library_module = shared_lib_consumer.load_library_module
+
+        def loaded(loader):
+            key = loader._cache_key(loader._library_path("example"))
+            names = [stat.name for stat in loader.stats()]
+            return names, key in shared_lib_manager._HANDLES
+
+        def record(name, **kwargs):
+            load_library_module(name, **kwargs)
+            deferred.append(loaded(shared_lib_consumer._find_loader(name)))
+
+        shared_lib_consumer.load_library_module = record
+        import pylibexample
+
+        assert deferred == [([], False)]
+        loader = shared_lib_consumer._find_loader("libexample")
+        assert loaded(loader) == (["example"], True)
+        assert pylibexample.pylibexample.square(4) == 16
+        """,
+    )
+
+
+@pytest.mark.parametrize("manifest", [True, False])
+def test_manifest_discovery(manifest: bool, package_wheelhouse: Path) -> None:  # noqa: FBT001
+    """Show that consumers load libraries without importing a provider's manifest."""
+    env = basic_test(package_wheelhouse, load_mode="LOCAL", manifest=manifest)
+    env.run(
+        f"""
+        import sys
+        import shared_lib_consumer
+        assert "libexample" in shared_lib_consumer.registered_library_modules()
+        import pylibexample
+        assert pylibexample.pylibexample.square(4) == 16
+        assert ("libexample" in sys.modules) is {not manifest}
+        """,
+    )
+
+
+def test_manifest_matches_loader(package_wheelhouse: Path) -> None:
+    """Test that a manifest describes the same libraries as the package's loader."""
+    root = dir_test("manifest_matches_loader")
+    library_name, cpp_package_name, _ = names("example")
+    make_cpp_pkg(
+        root,
+        cpp_package_name,
+        [f"{library_name}_1", f"{library_name}_2"],
+        "LOCAL",
+        binding="LAZY",
+        chain=True,
+    )
+    env = VEnv(root, package_wheelhouse)
+    env.build_wheels([root / cpp_package_name])
+    env.install(cpp_package_name, "shared_lib_consumer", "--no-index")
+    env.run(
+        """
+        import sys
+        import shared_lib_consumer
+
+        def describe(loader):
+            return (
+                {
+                    name: library._resolve()
+                    for name, library in loader._libraries.items()
+                },
+                loader._flags,
+                loader._dependencies,
+                loader._order,
+                loader._levels,
+            )
+
+        from_manifest = shared_lib_consumer._find_loader("libexample")
+        assert "libexample" not in sys.modules
+        import libexample
+        assert describe(from_manifest) == describe(libexample.loader)
+        assert from_manifest._dependencies["example_2"] == ("example_1",)
+        """,
+    )
+
+
+def test_inspect_library(local_env: VEnv) -> None:
+    """Test reading the headers of a built library and adding it to a manifest."""
+    local_env.run(
+        """
+        import importlib.util
+        import json
+        import os
+        import platform
+        import shutil
+        import subprocess
+        import sys
+        import tempfile
+
+        import shared_lib_manager
+
+        root = importlib.util.find_spec("libexample").submodule_search_locations[0]
+        file_name = {
+            "Linux": "libexample.so",
+            "Darwin": "libexample.dylib",
+            "Windows": "example.dll",
+        }[platform.system()]
+        path = os.path.join(root, "lib", file_name)
+
+        info = shared_lib_manager.read_library_info(path)
+        assert os.path.basename(info.soname).lower() == file_name.lower()
+        subprocess.run(
+            [sys.executable, "-m", "shared_lib_manager", "inspect", path], check=True
+        )
+
+        # The manifest is written for a copy so that the installed one is untouched.
+        root = tempfile.mkdtemp()
+        os.mkdir(os.path.join(root, "lib"))
+        path = shutil.copy(path, os.path.join(root, "lib"))
+        subprocess.run(
+            [
+                sys.executable,
+                "-m",
+                "shared_lib_manager",
+                "manifest",
+                root,
+                f"example={path}",
+            ],
+            check=True,
+        )
+        with open(os.path.join(root, "shared_libs.json")) as f:
+            manifest = json.load(f)
+        library = manifest["libraries"]["example"]
+        assert library[platform.system()] == f"lib/{file_name}"
+        assert library["info"][platform.system()]["soname"] == info.soname
+        """,
+    )
+
+
+@pytest.mark.parametrize("asynchronous", [False, True])
+def test_load_library_modules(local_env: VEnv, asynchronous: bool) -> None:  # noqa: FBT001
+    """Test loading the libraries of several modules at once, skipping missing ones.
+
+    The modules are either loaded in one batch or with concurrent awaits from an event
+    loop, and each library must be opened only once.
+    """
+    local_env.run(
+        f"""
+        import asyncio
+        import os
+        import shared_lib_consumer
+
+        async def main():
+            await asyncio.gather(
+                shared_lib_consumer.load_library_module_async("libexample"),
+                shared_lib_consumer.load_library_module_async("libexample"),
+                shared_lib_consumer.load_library_module_async("nonexistent"),
+            )
+
+        if {asynchronous}:
+            asyncio.run(main())
+        else:
+            shared_lib_consumer.load_library_modules(
+                ["libexample", "nonexistent", "libexample"], parallel=True
+            )
+        import libexample
+        import shared_lib_manager
+        loader = shared_lib_manager.LibraryLoader.from_manifest(
+            os.path.join(
+                os.path.dirname(libexample.__file__), shared_lib_manager.MANIFEST_NAME
+            )
+        )
+        (stats,) = loader.stats()
+        assert not stats.cache_hit
+        import pylibexample
+        assert pylibexample.pylibexample.square(4) == 16
+        """,
+    )
+
+
+def test_batched_load_order(local_env: VEnv) -> None:
+    """Test that batching libraries by their flags keeps them in load order."""
+    local_env.run(
+        """
+        import os
+        import shutil
+        import tempfile
+        import libexample
+        import shared_lib_manager
+
+        platform_name = shared_lib_manager._platform_name()
+        path = libexample.loader._libraries["example"]._resolve()
+        directory = tempfile.mkdtemp()
+        loaders = []
+        for i, mode in enumerate(["LOCAL", "GLOBAL", "LOCAL"]):
+            copy = os.path.join(directory, f"{i}_{os.path.basename(path)}")
+            shutil.copy(path, copy)
+            library = shared_lib_manager.PlatformLibrary(**{platform_name: copy})
+            loaders.append(
+                shared_lib_manager.LibraryLoader(
+                    {f"example_{i}": library}, mode=shared_lib_manager.LoadMode[mode]
+                )
+            )
+        events = []
+        shared_lib_manager.add_trace_hook(events.append)
+        shared_lib_manager.load_all(loaders)
+        assert [event.name for event in events] == [
+            "example_0", "example_1", "example_2"
+        ]
+        starts = [event.start_time for event in events]
+        assert starts == sorted(starts)
+        """,
+    )
+
+
+def test_missing_providers(local_env: VEnv) -> None:
+    """Test that providers found to be missing are not searched for again."""
+    local_env.run(
+        """
+        import importlib
+        import sys
+
+        searches = []
+
+        class Finder:
+            @staticmethod
+            def find_spec(name, *args):
+                if name == "nonexistent":
+                    searches.append(name)
+
+        sys.meta_path.insert(0, Finder)
+        import shared_lib_consumer
+        shared_lib_consumer.load_library_module("nonexistent")
+        shared_lib_consumer.load_library_modules(["nonexistent", "libexample"])
+        assert len(searches) == 1
+        importlib.invalidate_caches()
+        shared_lib_consumer.load_library_module("nonexistent")
+        assert len(searches) == 2
+        shared_lib_consumer.load_library_module("nonexistent", registered_only=True)
+        assert len(searches) == 2
+        shared_lib_consumer.load_library_module("libexample", registered_only=True)
+        import pylibexample
+        assert pylibexample.pylibexample.square(4) == 16
+
+        # A provider that exists but fails to import is not remembered as missing.
+        import os
+        import tempfile
+        provider_dir = tempfile.mkdtemp()
+        with open(os.path.join(provider_dir, "broken_provider.py"), "w") as f:
+            f.write("import nonexistent_dependency")
+        sys.path.insert(0, provider_dir)
+        for _ in range(2):
+            try:
+                shared_lib_consumer.load_library_module("broken_provider")
+            except ModuleNotFoundError as e:
+                assert e.name == "nonexistent_dependency"
+            else:
+                raise AssertionError("broken_provider was imported")
+        """,
+    )
+
+
+def test_trace_hooks(local_env: VEnv) -> None:
+    """Test that library loads are reported to trace hooks and audit hooks."""
+    local_env.run(
+        """
+        import os
+        import sys
+        audited = []
+        sys.addaudithook(
+            lambda event, args: event == "shared_lib_manager.load"
+            and audited.append(args)
+        )
+        import shared_lib_consumer
+        import shared_lib_manager
+
+        events = []
+        shared_lib_manager.add_trace_hook(events.append)
+        shared_lib_consumer.load_library_module("libexample")
+        (event,) = events
+        assert event.name == "example" and event.error is None
+        assert not event.system and not event.cache_hit and event.duration > 0
+        assert audited == [tuple(event)]
+
+        shared_lib_manager.remove_trace_hook(events.append)
+        path = os.path.abspath("nonexistent")
+        platform_name = shared_lib_manager._platform_name()
+        loader = shared_lib_manager.LibraryLoader(
+            {"missing": shared_lib_manager.PlatformLibrary(**{platform_name: path})}
+        )
+        try:
+            loader.load()
+        except OSError:
+            pass
+        assert len(events) == 1
+        assert audited[-1][0] == "missing" and audited[-1][-1]
+        """,
+        env={"SHARED_LIB_MANAGER_TRACE": "1"},
+    )
+
+
+def test_symbol_lookup(local_env: VEnv) -> None:
+    """Test calling a library function through the cached symbol table."""
+    local_env.run(
+        """
+        import ctypes
+        import libexample
+        square = libexample.loader.symbol(
+            "example", "square", ctypes.c_int, [ctypes.c_int]
+        )
+        assert square(4) == 16
+        assert libexample.loader.symbol(
+            "example", "square", ctypes.c_int, (ctypes.c_int,)
+        ) is square
+        try:
+            libexample.loader.symbol("example", "nonexistent")
+        except AttributeError:
+            pass
+        else:
+            raise AssertionError("Expected a missing symbol to raise")
+        """,
+    )
+
+
+def test_concurrent_load(local_env: VEnv) -> None:
+    """Test that loads racing from several threads open each library once."""
+    local_env.run(
+        """
+        import threading
+        import libexample
+        import shared_lib_consumer
+        import shared_lib_manager
+
+        loaders = [libexample.loader] + [
+            shared_lib_manager.LibraryLoader.from_manifest(
+                shared_lib_consumer._find_manifest("libexample")
+            )
+        ]
+        barrier = threading.Barrier(8)
+
+        def load(i):
+            barrier.wait()
+            loaders[i % 2].load(parallel=bool(i % 3))
+
+        threads = [threading.Thread(target=load, args=(i,)) for i in range(8)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        stats = [stat for loader in loaders for stat in loader.stats()]
+        assert [stat.cache_hit for stat in stats].count(False) == 1
+        assert loaders[0].handle("example")._handle == loaders[1].handle(
+            "example"
+        )._handle
+        import pylibexample
+        assert pylibexample.pylibexample.square(4) == 16
+        """,
+    )
+
+
+def test_dependency_order(local_env: VEnv) -> None:
+    """Test sorting libraries by their declared dependencies."""
+    local_env.run(
+        """
+        import shared_lib_manager
+
+        order, levels = shared_lib_manager._dependency_order(
+            {
+                "app": ("gui", "net"),
+                "gui": ("core",),
+                "net": ("core", "tls"),
+                "tls": (),
+                "core": (),
+                "tool": (),
+            }
+        )
+        # Dependencies come first, and the original order is kept otherwise.
+        assert order == ["core", "gui", "tls", "net", "app", "tool"], order
+        assert levels == {
+            "core": 0, "tls": 0, "tool": 0, "gui": 1, "net": 1, "app": 2
+        }, levels
+
+        def error(dependencies):
+            try:
+                shared_lib_manager._dependency_order(dependencies)
+            except ValueError as e:
+                return str(e)
+            raise AssertionError(f"No error for {dependencies}")
+
+        assert "a depends on unknown library missing" in error(
+            {"a": ("missing",)}
+        )
+        assert "a -> b -> c -> a" in error(
+            {"a": ("b",), "b": ("c",), "c": ("a",)}
+        )
+        assert "a -> a" in error({"a": ("a",)})
+
+        # Loaders check the declared dependencies when they are created.
+        platform_name = shared_lib_manager._platform_name()
+        library = shared_lib_manager.PlatformLibrary(
+            **{platform_name: "unused"}, depends_on=["missing"]
+        )
+        try:
+            shared_lib_manager.LibraryLoader({"a": library})
+        except ValueError as e:
+            assert "unknown library missing" in str(e)
+        else:
+            raise AssertionError("An unknown dependency was accepted")
+        """,
+    )
+
+
+def test_parallel_load_levels(package_wheelhouse: Path) -> None:
+    """Test that parallel loads open each dependency level after the one before it."""
+    root = dir_test("parallel_load_levels")
+    cpp_package_names = []
+    for base_name in ("chaina", "chainb"):
+        library_name, cpp_package_name, _ = names(base_name)
+        make_cpp_pkg(
+            root,
+            cpp_package_name,
+            [f"{library_name}_{i}" for i in range(3)],
+            "LOCAL",
+            chain=True,
+        )
+        cpp_package_names.append(cpp_package_name)
+    env = VEnv(root, package_wheelhouse)
+    env.build_wheels([root / name for name in cpp_package_names])
+    for cpp_package_name in cpp_package_names:
+        env.install(cpp_package_name, "--no-index")
+    env.run(
+        """
+        import libchaina
+        import libchainb
+        import shared_lib_manager
+
+        # Small libraries are loaded serially, since threads would only slow them.
+        loaders = [libchaina.loader, libchainb.loader]
+        for loader in loaders:
+            loader.load(parallel=True)
+            assert loader.parallel_speedup is None
+            loader.unload()
+
+        shared_lib_manager._PARALLEL_MIN_SIZE = 0
+        events = []
+        shared_lib_manager.add_trace_hook(events.append)
+        shared_lib_manager.load_all(loaders, parallel=True)
+        assert all(loader.parallel_speedup is not None for loader in loaders)
+        levels = [int(event.name.rpartition("_")[2]) for event in events]
+        assert levels == [0, 0, 1, 1, 2, 2], events
+        """,
+    )
+
+
+def test_concurrent_load_unload(local_env: VEnv) -> None:
+    """Test that a library loaded from several threads is released by one unload."""
+    local_env.run(
+        """
+        import threading
+        import shared_lib_consumer
+        import shared_lib_manager
+
+        manifest = shared_lib_consumer._find_manifest("libexample")
+        for _ in range(20):
+            loader = shared_lib_manager.LibraryLoader.from_manifest(manifest)
+            barrier = threading.Barrier(8)
+
+            def load(i):
+                barrier.wait()
+                loader.load(parallel=bool(i % 2))
+
+            threads = [threading.Thread(target=load, args=(i,)) for i in range(8)]
+            for thread in threads:
+                thread.start()
+            for thread in threads:
+                thread.join()
+            assert loader.unload() == ["example"]
+            assert not shared_lib_manager._HANDLES
+        """,
+    )
+
+
+def test_load_stats(local_env: VEnv) -> None:
+    """Test the statistics of loaded libraries and their dump at exit."""
+    local_env.run(
+        """
+        import json
+        import os
+        import subprocess
+        import sys
+        import tempfile
+        import libexample
+        import shared_lib_manager
+
+        path = libexample.loader._libraries["example"]._resolve()
+        libexample.loader.load()
+        (stat,) = libexample.loader.stats()
+        assert stat.name == "example" and os.path.samefile(stat.path, path)
+        assert not stat.cache_hit and not stat.system and stat.load_time > 0
+        assert stat.file_size == os.path.getsize(path)
+        if sys.platform.startswith("linux"):
+            assert stat.mapped_size > 0
+
+        # A second loader of the library reports the first load's time as a hit.
+        other = shared_lib_manager.LibraryLoader(
+            {"example": libexample.loader._libraries["example"]}
+        )
+        other.load()
+        (other_stat,) = other.stats()
+        assert other_stat.cache_hit and other_stat.load_time == stat.load_time
+
+        code = "import pylibexample"
+        with tempfile.TemporaryDirectory() as directory:
+            destination = os.path.join(directory, "stats.json")
+            subprocess.run(
+                [sys.executable, "-c", code],
+                env={**os.environ, "SHARED_LIB_MANAGER_STATS": destination},
+                check=True,
+            )
+            with open(destination) as f:
+                (dumped,) = json.load(f)
+        assert dumped["name"] == "example" and not dumped["cache_hit"]
+        assert dumped["file_size"] == stat.file_size
+
+        stderr = subprocess.run(
+            [sys.executable, "-c", code],
+            env={**os.environ, "SHARED_LIB_MANAGER_STATS": "1"},
+            check=True,
+            capture_output=True,
+            text=True,
+        ).stderr
+        assert "shared_lib_manager: loaded 1 libraries" in stderr, stderr
+        assert "bundled  example (" in stderr, stderr
+        """,
+    )
+
+
+@pytest.mark.skipif(
+    platform.system() != "Linux", reason="the system library is found on Linux"
+)
+def test_resolution_cache(local_env: VEnv) -> None:
+    """Test that remembered system lookups are invalidated by search path changes."""
+    local_env.run(
+        """
+        import os
+        import shutil
+        import subprocess
+        import sys
+        import tempfile
+
+        root = tempfile.mkdtemp()
+        cache = os.path.join(root, "cache")
+        search = os.path.join(root, "search")
+        os.mkdir(search)
+        check = (
+            "import os, libexample; libexample.loader.load(prefer_system=True); "
+            "(stat,) = libexample.loader.stats(); "
+            "print(stat.system, os.path.dirname(stat.path))"
+        )
+
+        def load():
+            system, directory = subprocess.run(
+                [sys.executable, "-c", check],
+                env={
+                    **os.environ,
+                    "SHARED_LIB_MANAGER_RESOLUTION_CACHE": cache,
+                    "LD_LIBRARY_PATH": search,
+                },
+                check=True,
+                capture_output=True,
+                text=True,
+            ).stdout.split()
+            return system == "True", directory
+
+        assert load()[0] is False
+        # A system copy added without changing the directory's modification time is
+        # not found, since the failed lookup is remembered.
+        import libexample
+        bundled = libexample.loader._libraries["example"]._resolve()
+        stat = os.stat(search)
+        shutil.copy(bundled, search)
+        os.utime(search, ns=(stat.st_atime_ns, stat.st_mtime_ns))
+        assert load()[0] is False
+        os.utime(search, ns=(stat.st_atime_ns, stat.st_mtime_ns + 10**9))
+        assert load() == (True, search)
+        assert load() == (True, search)
+
+        # Entries also depend on the search path variable, the resolved file and the
+        # files of the default search path such as /etc/ld.so.cache.
+        os.environ["SHARED_LIB_MANAGER_RESOLUTION_CACHE"] = cache
+        os.environ["LD_LIBRARY_PATH"] = search
+        import shared_lib_manager
+        resolution_cache = shared_lib_manager._ResolutionCache
+        name = os.path.basename(bundled)
+        resolved = os.path.join(search, name)
+        assert resolution_cache.lookup(name) == (True, resolved)
+
+        os.environ["LD_LIBRARY_PATH"] = root
+        assert resolution_cache.lookup(name) == (False, None)
+        os.environ["LD_LIBRARY_PATH"] = search
+        assert resolution_cache.lookup(name) == (True, resolved)
+
+        os.utime(resolved, ns=(0, 0))
+        assert resolution_cache.lookup(name) == (False, None)
+        resolution_cache.store(name, resolved)
+
+        ld_so_cache = os.path.join(root, "ld.so.cache")
+        open(ld_so_cache, "w").close()
+        shared_lib_manager._DEFAULT_SEARCH_PATHS["Linux"] = (ld_so_cache,)
+        resolution_cache.store(name, resolved)
+        assert resolution_cache.lookup(name) == (True, resolved)
+        os.utime(ld_so_cache, ns=(0, 0))
+        assert resolution_cache.lookup(name) == (False, None)
+        """,
+    )
+
+
+def test_library_variants(local_env: VEnv) -> None:
+    """Test that the first variant supported by the CPU is loaded."""
+    local_env.run(
+        """
+        import os
+        import sys
+        os.environ["SHARED_LIB_MANAGER_CPU_FEATURES"] = "sse4_2,avx2"
+        import libexample
+        import shared_lib_manager
+
+        platform_name = shared_lib_manager._platform_name()
+        path = libexample.loader._libraries["example"]._resolve()
+        missing = os.path.join(os.path.dirname(path), "missing")
+        library = shared_lib_manager.PlatformLibrary(
+            **{platform_name: missing},
+            variants=[
+                shared_lib_manager.LibraryVariant(
+                    ["avx512f"], **{platform_name: missing}
+                ),
+                shared_lib_manager.LibraryVariant(["avx2"], **{platform_name: path}),
+            ],
+        )
+        loader = shared_lib_manager.LibraryLoader({"example": library})
+        loader.load()
+        assert os.path.samefile(loader.stats()[0].path, path)
+        assert shared_lib_manager.cpu_features() == {"sse4_2", "avx2"}
+
+        # Detection with and without the compiled module reports the same names.
+        features = shared_lib_manager._detect_cpu_features()
+        assert features <= shared_lib_manager._CPU_FEATURE_NAMES
+        if shared_lib_manager._native is not None and sys.platform == "linux":
+            assert set(shared_lib_manager._native.cpu_features()) == features
+        try:
+            shared_lib_manager.LibraryVariant(["avx3"], **{platform_name: path})
+        except ValueError as e:
+            assert "avx3" in str(e)
+        else:
+            raise AssertionError("An unknown feature was accepted")
+        """,
+    )
+
+
+def test_fast_load_profile(package_wheelhouse: Path) -> None:
+    """Test that the fast-load profile only exports the API and avoids the PLT."""
+    root = dir_test("fast_load")
+    library_name, cpp_package_name, python_package_name = names("fastload")
+    num_symbols = 16
+    make_cpp_pkg(
+        root,
+        cpp_package_name,
+        library_name,
+        "LOCAL",
+        num_symbols=num_symbols,
+        fast_load=True,
+        link_now=True,
+    )
+    make_python_pkg(
+        root,
+        python_package_name,
+        library_name,
+        cpp_package_name,
+        dependencies=["shared_lib_consumer", cpp_package_name],
+        build_dependencies=["scikit-build-core", cpp_package_name],
+    )
+
+    env = VEnv(root, package_wheelhouse)
+    env.build_wheels([root / cpp_package_name, root / python_package_name])
+    env.install(python_package_name, "--no-index")
+    env.run(
+        f"""
+        import {python_package_name}
+        assert {python_package_name}.{python_package_name}.square(4) == 16
+        """,
+    )
+
+    (wheel,) = Path(env.wheelhouse).glob(f"{cpp_package_name}-*.whl")
+    (library,) = json.loads(
+        env.run(
+            f"""
+            import shared_lib_manager
+            shared_lib_manager._main(["relocations", {str(wheel)!r}])
+            """
+        ).stdout
+    )
+    assert library["exported"] == num_symbols + 1
+    if library["file_format"] == "ELF":
+        # Calls between the library's own functions are bound directly.
+        assert library["plt"] == 0
+        assert library["bind_now"]
+        assert library["gnu_hash"]
+
+
+def test_identical_libraries(local_env: VEnv) -> None:
+    """Test that identical copies of a library are loaded once and can be linked."""
+    local_env.run(
+        """
+        import os
+        import shutil
+        import tempfile
+        import libexample
+        import shared_lib_manager
+
+        path = libexample.loader._libraries["example"]._resolve()
+        package_dirs = []
+        for _ in range(2):
+            package_dir = tempfile.mkdtemp()
+            copy = shutil.copy(path, package_dir)
+            shared_lib_manager._main(["manifest", package_dir, f"example={copy}"])
+            package_dirs.append(package_dir)
+
+        first, second = (
+            shared_lib_manager.LibraryLoader.from_manifest(
+                os.path.join(package_dir, shared_lib_manager.MANIFEST_NAME)
+            )
+            for package_dir in package_dirs
+        )
+        first.load()
+        second.load()
+        assert second.stats()[0].cache_hit
+        assert second.handle("example")._handle == first.handle("example")._handle
+
+        assert shared_lib_manager._main(["dedupe", *package_dirs]) == 0
+        assert os.path.samefile(
+            *(
+                os.path.join(package_dir, os.path.basename(path))
+                for package_dir in package_dirs
+            )
+        )
+        """,
+    )
+
+
+@pytest.mark.skipif(
+    platform.system() != "Linux", reason="mapped files are read from /proc"
+)
+def test_identical_libraries_promotion(local_env: VEnv) -> None:
+    """Test that promoting an identical copy of a loaded library reuses the first."""
+    local_env.run(
+        """
+        import os
+        import shutil
+        import tempfile
+        import libexample
+        import shared_lib_manager
+
+        path = libexample.loader._libraries["example"]._resolve()
+        loaders = []
+        copies = []
+        for mode in ("LOCAL", "GLOBAL"):
+            package_dir = tempfile.mkdtemp()
+            copies.append(shutil.copy(path, package_dir))
+            shared_lib_manager._main(
+                ["manifest", "--mode", mode, package_dir, f"example={copies[-1]}"]
+            )
+            loaders.append(
+                shared_lib_manager.LibraryLoader.from_manifest(
+                    os.path.join(package_dir, shared_lib_manager.MANIFEST_NAME)
+                )
+            )
+        for loader in loaders:
+            loader.load()
+
+        with open("/proc/self/maps") as f:
+            mapped = {line.split()[-1] for line in f if len(line.split()) > 5}
+        copies = [os.path.realpath(copy) for copy in copies]
+        assert [copy in mapped for copy in copies] == [True, False]
+        assert loaders[1].handle("example")._handle == loaders[0].handle(
+            "example"
+        )._handle
+        """,
+    )
+
+
+def test_warmup(local_env: VEnv) -> None:
+    """Test that warming up reads the files of libraries not loaded yet."""
+    local_env.run(
+        """
+        import os
+        import sys
+        import time
+        import libexample
+        import shared_lib_manager
+
+        path = libexample.loader._library_path("example")
+        warmed = []
+        warmup_files = shared_lib_manager._warmup_files
+        shared_lib_manager._warmup_files = lambda paths: (
+            warmed.append(list(paths)) or warmup_files(paths)
+        )
+
+        if hasattr(os, "posix_fadvise") and sys.platform.startswith("linux"):
+            import ctypes
+            import mmap
+
+            libc = ctypes.CDLL(None, use_errno=True)
+            libc.mmap.restype = ctypes.c_void_p
+            libc.mmap.argtypes = (
+                ctypes.c_void_p,
+                ctypes.c_size_t,
+                ctypes.c_int,
+                ctypes.c_int,
+                ctypes.c_int,
+                ctypes.c_long,
+            )
+            libc.mincore.argtypes = (ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p)
+            libc.munmap.argtypes = (ctypes.c_void_p, ctypes.c_size_t)
+
+            def resident():
+                size = os.path.getsize(path)
+                pages = (ctypes.c_ubyte * -(-size // mmap.PAGESIZE))()
+                fd = os.open(path, os.O_RDONLY)
+                try:
+                    address = libc.mmap(
+                        None, size, mmap.PROT_READ, mmap.MAP_SHARED, fd, 0
+                    )
+                    assert libc.mincore(address, size, pages) == 0
+                    libc.munmap(address, size)
+                finally:
+                    os.close(fd)
+                return all(page & 1 for page in pages)
+
+            fd = os.open(path, os.O_RDONLY)
+            try:
+                # Dirty pages cannot be dropped, so they are written out first.
+                os.fsync(fd)
+                os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+            finally:
+                os.close(fd)
+            # Some file systems keep files in memory regardless, and only an evicted
+            # file shows that warming up reads it.
+            if not resident():
+                libexample.loader.warmup()
+                deadline = time.monotonic() + 10
+                while not resident() and time.monotonic() < deadline:
+                    time.sleep(0.01)
+                assert resident()
+
+        warmed.clear()
+        libexample.loader.warmup(background=True).join()
+        assert warmed == [[path]]
+        libexample.loader.load()
+        assert libexample.loader.warmup() is None
+        assert warmed[-1] == []
+        """,
+    )
+
+
+def test_memory_and_unload(local_env: VEnv) -> None:
+    """Test memory accounting and unloading libraries that are no longer used."""
+    local_env.run(
+        """
+        import sys
+        import libexample
+        import shared_lib_manager
+
+        other = shared_lib_manager.LibraryLoader(
+            {"example": libexample.loader._libraries["example"]}
+        )
+        libexample.loader.load()
+        other.load()
+        (memory,) = libexample.loader.memory()
+        assert memory.name == "example"
+        if sys.platform.startswith("linux"):
+            assert memory.mapped_size > 0 and memory.rss is not None
+
+        # The other loader still holds the library.
+        assert libexample.loader.unload() == []
+        assert libexample.loader.stats() == []
+        assert other.unload() == ["example"]
+
+        # Libraries that extension modules link to stay usable after unloading.
+        libexample.loader.load()
+        import pylibexample
+        assert libexample.loader.unload() == ["example"]
+        assert pylibexample.pylibexample.square(4) == 16
+        """,
+    )
+
+
+@pytest.mark.skipif(
+    platform.system() != "Linux", reason="bindings are traced with LD_DEBUG"
+)
+@pytest.mark.parametrize("binding", ["NOW", "LAZY"])
+def test_binding_modes(binding: str, package_wheelhouse: Path) -> None:
+    """Test when the symbols a library uses from its dependency are bound."""
+    root = dir_test("binding_modes", binding=binding)
+    library_name, cpp_package_name, _ = names("binding")
+    make_cpp_pkg(
+        root,
+        cpp_package_name,
+        [f"{library_name}_0", f"{library_name}_1"],
+        "LOCAL",
+        binding=binding,
+        chain=True,
+    )
+    env = VEnv(root, package_wheelhouse)
+    env.build_wheels([root / cpp_package_name])
+    env.install(cpp_package_name, "--no-index")
+    env.run(
+        f"""
+        import os
+        import subprocess
+        import sys
+
+        code = (
+            "import ctypes, sys, libbinding; "
+            "libbinding.loader.load(); "
+            "print('-- loaded --', file=sys.stderr, flush=True); "
+            "depth = libbinding.loader.symbol("
+            "'binding_1', 'binding_1_depth', ctypes.c_int); "
+            "assert depth() == 2; "
+            "print('-- called --', file=sys.stderr, flush=True)"
+        )
+        env = {{**os.environ, "LD_DEBUG": "bindings"}}
+        env.pop("LD_BIND_NOW", None)
+        stderr = subprocess.run(
+            [sys.executable, "-c", code],
+            env=env,
+            check=True,
+            capture_output=True,
+            text=True,
+        ).stderr
+        bound = stderr.index("normal symbol `binding_0_depth'")
+        loaded = stderr.index("-- loaded --")
+        called = stderr.index("-- called --")
+        if {binding == "LAZY"}:
+            assert loaded < bound < called, stderr
+        else:
+            assert bound < loaded, stderr
+        """,
+    )
+
+
+@pytest.mark.skipif(
+    platform.system() == "Windows", reason="RTLD_NODELETE is not available"
+)
+def test_nodelete(local_env: VEnv) -> None:
+    """Test that libraries loaded with nodelete stay loaded after unloading."""
+    local_env.run(
+        """
+        import os
+        import sys
+        import libexample
+        import shared_lib_manager
+
+        library = libexample.loader._libraries["example"]
+        path = os.path.realpath(library._resolve())
+
+        def mapped():
+            with open("/proc/self/maps") as f:
+                return path in f.read()
+
+        for nodelete in (False, True):
+            loader = shared_lib_manager.LibraryLoader(
+                {"example": library}, nodelete=nodelete
+            )
+            loader.load()
+            assert loader.unload() == ([] if nodelete else ["example"])
+            assert (path in shared_lib_manager._HANDLES) is nodelete
+            if sys.platform.startswith("linux"):
+                assert mapped() is nodelete
+        """,
+    )
+
+
+def test_startup_preload(local_env: VEnv) -> None:
+    """Test that the startup hook preloads libraries for the foreground load."""
+    local_env.run(
+        """
+        import shared_lib_manager
+        assert shared_lib_manager._preload_thread is not None
+        assert shared_lib_manager.wait_for_preload(timeout=60)
+        import libexample
+        libexample.loader.load()
+        assert all(stat.cache_hit for stat in libexample.loader.stats())
+        import pylibexample
+        assert pylibexample.pylibexample.square(4) == 16
+        """,
+        env={"SHARED_LIB_MANAGER_PRELOAD": "libexample"},
+    )
+
+
+@pytest.mark.skipif(platform.system() == "Windows", reason="fork is not available")
+def test_preload_before_fork(local_env: VEnv) -> None:
+    """Test that workers forked after preloading reuse the parent's libraries."""
+    local_env.run(
+        """
+        import os
+        import libexample
+        import shared_lib_manager
+
+        shared_lib_manager.preload_all()
+        handle = libexample.loader.handle("example")._handle
+        pid = os.fork()
+        if pid == 0:
+            libexample.loader.load()
+            ok = libexample.loader.handle("example")._handle == handle
+            import pylibexample
+            ok = ok and pylibexample.pylibexample.square(4) == 16
+            os._exit(0 if ok else 1)
+        _, status = os.waitpid(pid, 0)
+        assert status == 0
+        """,
+    )
+
+
+def test_load_plan(local_env: VEnv) -> None:
+    """Test replaying a compiled load plan at startup and detecting stale plans."""
+    local_env.run(
+        """
+        import json
+        import os
+        import subprocess
+        import sys
+        import tempfile
+
+        check = (
+            "import libexample; libexample.loader.load(); "
+            "print(all(stat.cache_hit for stat in libexample.loader.stats()))"
+        )
+
+        with tempfile.TemporaryDirectory() as directory:
+            plan = os.path.join(directory, "plan.json")
+            subprocess.run(
+                [sys.executable, "-m", "shared_lib_manager", "plan", plan], check=True
+            )
+            with open(plan) as f:
+                (library,) = json.load(f)["libraries"]
+            assert library["name"] == "example"
+
+            def replay():
+                return subprocess.run(
+                    [sys.executable, "-c", check],
+                    env={**os.environ, "SHARED_LIB_MANAGER_LOAD_PLAN": plan},
+                    check=True,
+                    capture_output=True,
+                    text=True,
+                ).stdout.strip()
+
+            assert replay() == "True"
+            os.utime(library["path"], ns=(0, library["mtime_ns"] + 1))
+            assert replay() == "False"
+        import pylibexample
+        assert pylibexample.pylibexample.square(4) == 16
+        """,
+    )
+
+
+@pytest.mark.skipif(
+    platform.system() != "Linux", reason="the system library is found on Linux"
+)
+def test_load_plan_prefer_system(local_env: VEnv) -> None:
+    """Test that replayed system libraries are cache hits for prefer_system loads."""
+    local_env.run(
+        """
+        import importlib.util
+        import json
+        import os
+        import subprocess
+        import sys
+        import tempfile
+
+        root = importlib.util.find_spec("libexample").submodule_search_locations[0]
+        # The bundled library doubles as the system copy found by the lookup.
+        system_env = {**os.environ, "LD_LIBRARY_PATH": os.path.join(root, "lib")}
+        check = (
+            "import libexample; libexample.loader.load(prefer_system=True); "
+            "print([(stat.cache_hit, stat.system) "
+            "for stat in libexample.loader.stats()])"
+        )
+
+        with tempfile.TemporaryDirectory() as directory:
+            plan = os.path.join(directory, "plan.json")
+            subprocess.run(
+                [
+                    sys.executable,
+                    "-m",
+                    "shared_lib_manager",
+                    "plan",
+                    plan,
+                    "--prefer-system",
+                ],
+                env=system_env,
+                check=True,
+            )
+            with open(plan) as f:
+                (library,) = json.load(f)["libraries"]
+            assert library["system_name"] == "libexample.so"
+
+            replayed = subprocess.run(
+                [sys.executable, "-c", check],
+                env={**system_env, "SHARED_LIB_MANAGER_LOAD_PLAN": plan},
+                check=True,
+                capture_output=True,
+                text=True,
+            ).stdout.strip()
+            assert replayed == "[(True, True)]", replayed
+        """,
+    )
+
+
+@pytest.mark.usefixtures("local_env")
+def test_wheel_cache(package_wheelhouse: Path) -> None:
+    """Test that a package rendered identically in another test is not rebuilt."""
+    cached = set(WHEEL_CACHE.iterdir())
+
+    root = dir_test("wheel_cache")
+    library_name, cpp_package_name, _ = names("example")
+    make_cpp_pkg(root, cpp_package_name, library_name, "LOCAL", square_as_cube=False)
+    env = VEnv(root, package_wheelhouse)
+    env.wheel(root / cpp_package_name)
+    assert set(WHEEL_CACHE.iterdir()) == cached
+    assert list(Path(env.wheelhouse).glob(f"{cpp_package_name}-*.whl"))
+
+
+@pytest.mark.parametrize("manifest", [True, False])
+def test_two_libraries_in_package(
+    load_mode: str,
+    manifest: bool,  # noqa: FBT001
+    package_wheelhouse: Path,
+) -> None:
     """Test a single Python extension loading an associated library."""
-    two_libraries_in_package_test(package_wheelhouse, load_mode=load_mode)
+    two_libraries_in_package_test(
+        package_wheelhouse, load_mode=load_mode, manifest=manifest
+    )
 
 
 def test_lib_only_available_at_build_test(package_wheelhouse: Path) -> None:
@@ -813,6 +2315,53 @@ def test_two_colliding_packages(load_mode: str, package_wheelhouse: Path) -> Non
             raise
 
 
+def test_symbol_conflicts(package_wheelhouse: Path) -> None:
+    """Test reporting the symbol collision between two packages' libraries."""
+    env = two_colliding_packages_test(package_wheelhouse, load_mode="LOCAL")
+    env.run(
+        """
+        import shared_lib_consumer
+        issues = shared_lib_consumer.find_library_conflicts()
+        assert any(
+            "square" in issue and "libfoo" in issue and "libbar" in issue
+            for issue in issues
+        ), issues
+        """,
+    )
+
+
+def test_symbol_conflicts_on_load(package_wheelhouse: Path) -> None:
+    """Test that conflicts are warned about on load, reading each library once."""
+    env = two_colliding_packages_test(package_wheelhouse, load_mode="LOCAL")
+    env.run(
+        """
+        import warnings
+        import shared_lib_manager
+
+        parsed = []
+        read_library_symbols = shared_lib_manager.read_library_symbols
+        shared_lib_manager.read_library_symbols = lambda path: (
+            parsed.append(path) or read_library_symbols(path)
+        )
+        with warnings.catch_warnings(record=True) as caught:
+            warnings.simplefilter("always")
+            import pylibfoo
+            import pylibbar
+        assert len(parsed) == len(set(parsed)) == 2, parsed
+        assert all(
+            warning.category is shared_lib_manager.LibraryConflictWarning
+            for warning in caught
+        ), caught
+        messages = [str(warning.message) for warning in caught]
+        assert any(
+            "square" in message and "libfoo" in message and "libbar" in message
+            for message in messages
+        ), messages
+        """,
+        env={"SHARED_LIB_MANAGER_CHECK_CONFLICTS": "1"},
+    )
+
+
 # TODO: Make this test work on Mac too
 @pytest.mark.skipif(
     platform.system() != "Linux", reason="RPATH only supported on Linux"
@@ -880,3 +2429,44 @@ def test_windows_unresolved_symbols(package_wheelhouse: Path) -> None:
             load_mode="GLOBAL",
             windows_unresolved_symbols=True,
         )
+
+
+@pytest.mark.skipif(
+    platform.system() != "Windows", reason="This test is Windows-specific"
+)
+def test_windows_system_library_on_path(local_env: VEnv) -> None:
+    """Test that system lookups on Windows find libraries in the PATH directories."""
+    local_env.run(
+        """
+        import os
+        import shutil
+        import subprocess
+        import sys
+        import tempfile
+
+        import libexample
+
+        bundled = libexample.loader._libraries["example"]._resolve()
+        check = (
+            "import libexample; libexample.loader.load(prefer_system=True); "
+            "(stat,) = libexample.loader.stats(); print(stat.system, stat.path)"
+        )
+        with tempfile.TemporaryDirectory() as directory:
+            copy = shutil.copy(bundled, directory)
+            path = os.environ["PATH"]
+            for search_path, system in (
+                (os.pathsep.join((directory, path)), True),
+                (path, False),
+            ):
+                output = subprocess.run(
+                    [sys.executable, "-c", check],
+                    env={**os.environ, "PATH": search_path},
+                    check=True,
+                    capture_output=True,
+                    text=True,
+                ).stdout.strip()
+                found, _, loaded = output.partition(" ")
+                assert found == str(system), output
+                assert os.path.samefile(loaded, copy if system else bundled), output
+        """,
+    )
@@ -0,0 +1,209 @@
+# SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION & AFFILIATES.
+# SPDX-License-Identifier: Apache-2.0
+
+"""Test loading environments with many library packages, libraries and consumers.
+
+These tests are skipped unless ``--scaling-json`` is passed, in which case the load
+times and memory use of every case are written to that file. The cases grow one
+dimension of the environment at a time, the number of wheels exporting libraries,
+the length of the dependency chains between their libraries or the number of symbols
+the libraries export, so that costs growing faster than linearly in any of them show
+up in the per-library figures. Every case also checks that each library is opened
+once, that the libraries resolve each other's symbols correctly and that no symbols
+clash between them.
+"""
+
+from __future__ import annotations
+
+import json
+import statistics
+from typing import TYPE_CHECKING
+
+import pytest
+from test_generated_projects import VEnv, dir_test, make_cpp_pkg, make_python_pkg, names
+
+if TYPE_CHECKING:
+    from pathlib import Path
+
+# The number of consumers that load a provider (and look for a missing optional one),
+# as in an environment with hundreds of packages depending on the providers.
+NUM_CONSUMERS = 256
+
+# The number of fresh processes to take the timings from.
+REPEAT = 3
+
+SCALING_SCRIPT = """
+    import json
+    import time
+
+    provider_names = {provider_names!r}
+    library_names = {library_names!r}
+
+    start = time.perf_counter()
+    import shared_lib_consumer
+    shared_lib_consumer.load_library_modules(provider_names)
+    loaded = time.perf_counter()
+    # Every consumer loads its provider and looks for an optional one that is missing.
+    for i in range({num_consumers}):
+        provider_name = provider_names[i % len(provider_names)]
+        shared_lib_consumer.load_library_module(provider_name)
+        shared_lib_consumer.load_library_module(f"missing_provider_{{i % 16}}")
+    consumed = time.perf_counter()
+    import {python_package_name}
+    module = {python_package_name}.{python_package_name}
+    depths = [getattr(module, f"{{name}}_depth")() for name in library_names]
+    squares = [getattr(module, f"{{name}}_square")(3) for name in library_names]
+    called = time.perf_counter()
+    conflicts = shared_lib_consumer.find_library_conflicts()
+    checked = time.perf_counter()
+
+    import shared_lib_manager
+    loaders = [shared_lib_consumer._find_loader(name) for name in provider_names]
+    stats = [stat for loader in loaders for stat in loader.stats()]
+    memory = [usage for loader in loaders for usage in loader.memory()]
+    try:
+        import resource
+    except ImportError:
+        max_rss = None
+    else:
+        max_rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    print(
+        json.dumps(
+            {{
+                "load": loaded - start,
+                "consumers": consumed - loaded,
+                "calls": called - consumed,
+                "conflicts_check": checked - called,
+                "depths": depths,
+                "squares": squares,
+                "conflicts": conflicts,
+                "loaded": [stat.name for stat in stats],
+                "opened": [stat.path for stat in stats if not stat.cache_hit],
+                "mapped_size": sum(usage.mapped_size or 0 for usage in memory),
+                "rss": sum(usage.rss or 0 for usage in memory),
+                "pss": sum(usage.pss or 0 for usage in memory),
+                "max_rss": max_rss,
+                "native": shared_lib_manager._native is not None,
+            }}
+        )
+    )
+"""
+
+
+@pytest.mark.scaling
+@pytest.mark.parametrize(
+    ("num_providers", "chain_length", "num_symbols"),
+    [
+        # More wheels exporting libraries.
+        (1, 1, 16),
+        (8, 1, 16),
+        (32, 1, 16),
+        (64, 1, 16),
+        # Deeper dependency chains between the libraries of a wheel.
+        (1, 8, 16),
+        (1, 32, 16),
+        (1, 64, 16),
+        # More exported symbols per library.
+        (4, 4, 1024),
+        (4, 4, 4096),
+    ],
+)
+def test_scaling(
+    num_providers: int,
+    chain_length: int,
+    num_symbols: int,
+    package_wheelhouse: Path,
+    scaling_results: list[dict],
+) -> None:
+    """Load many chained libraries from many wheels into one consumer.
+
+    Each provider wheel ships a chain of libraries in which every library links to
+    and calls into the one before it. A single extension module links to all the
+    libraries, with one prefix per library, and the consumer loads are repeated as
+    many times as an environment with hundreds of consumers would.
+    """
+    root = dir_test(
+        "scaling",
+        num_providers=str(num_providers),
+        chain_length=str(chain_length),
+        num_symbols=str(num_symbols),
+    )
+    provider_names = []
+    library_names = []
+    for i in range(num_providers):
+        base_name, cpp_package_name, _ = names(f"scale{i}")
+        provider_libraries = [f"{base_name}_{j}" for j in range(chain_length)]
+        make_cpp_pkg(
+            root,
+            cpp_package_name,
+            provider_libraries,
+            "LOCAL",
+            num_symbols=num_symbols,
+            chain=True,
+        )
+        provider_names.append(cpp_package_name)
+        library_names.extend(provider_libraries)
+    _, _, python_package_name = names("scale")
+    make_python_pkg(
+        root,
+        python_package_name,
+        library_names,
+        provider_names[0],
+        dependencies=["shared_lib_consumer", *provider_names],
+        build_dependencies=["scikit-build-core", *provider_names],
+        load_dynamic_lib=False,
+        chain=True,
+    )
+
+    env = VEnv(root, package_wheelhouse)
+    env.build_wheels(
+        [root / name for name in provider_names] + [root / python_package_name]
+    )
+    env.install(python_package_name, "--no-index")
+
+    script = SCALING_SCRIPT.format(
+        provider_names=provider_names,
+        library_names=library_names,
+        num_consumers=NUM_CONSUMERS,
+        python_package_name=python_package_name,
+    )
+    samples = [json.loads(env.run(script).stdout) for _ in range(REPEAT)]
+
+    for sample in samples:
+        assert sample["depths"] == [
+            position + 1
+            for _ in range(num_providers)
+            for position in range(chain_length)
+        ]
+        assert sample["squares"] == [9] * len(library_names)
+        assert sample["conflicts"] == []
+        # Every library is loaded by its provider's loader and opened exactly once.
+        assert sorted(sample["loaded"]) == sorted(library_names)
+        assert len(sample["opened"]) == len(library_names)
+        assert len(set(sample["opened"])) == len(library_names)
+
+    num_libraries = len(library_names)
+    median_load = statistics.median(sample["load"] for sample in samples)
+    median_consumers = statistics.median(sample["consumers"] for sample in samples)
+    scaling_results.append(
+        {
+            "num_providers": num_providers,
+            "chain_length": chain_length,
+            "num_libraries": num_libraries,
+            "num_symbols": num_symbols,
+            "num_consumers": NUM_CONSUMERS,
+            "native": samples[0]["native"],
+            "median_load": median_load,
+            "median_load_per_library": median_load / num_libraries,
+            "median_consumers": median_consumers,
+            "median_consumer_call": median_consumers / (2 * NUM_CONSUMERS),
+            "median_conflicts_check": statistics.median(
+                sample["conflicts_check"] for sample in samples
+            ),
+            "mapped_size": samples[0]["mapped_size"],
+            "rss": samples[0]["rss"],
+            "pss": samples[0]["pss"],
+            "max_rss": samples[0]["max_rss"],
+            "samples": samples,
+        }
+    )